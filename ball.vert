@@ -0,0 +1,18 @@
+#version 120
+
+// One instance per ball: the unit circle mesh scaled and moved onto the ball
+attribute vec2 corner;        // Unit circle vertex, shared by every ball
+attribute vec2 centre;        // Ball position, advanced once per instance
+attribute float radius;       // Ball radius, advanced once per instance
+attribute float colourIndex;  // Ball index modulo 3, advanced once per instance
+
+uniform float alpha;
+
+varying vec4 colour;
+
+void main() {
+    // Red, green and blue in turn by ball index, as before
+    colour = vec4(float(colourIndex < 0.5), float(colourIndex > 0.5 && colourIndex < 1.5), float(colourIndex > 1.5),
+                  alpha);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(centre + corner * radius, 0.0, 1.0);
+}
@@ -17,4 +17,42 @@ typedef struct {
     float padding;      // 4 bytes for alignment
 } __attribute__((aligned(16))) Ball;  // Ensure 16-byte alignment
 
+typedef struct {
+    int a;              // Lower ball index
+    int b;              // Higher ball index
+    float rewind;       // Time from first touch to step end, 0 if overlapping at step end
+    int padding;        // 4 bytes for alignment
+} Contact;
+
+// Simplified gravity force (units/sec²) shared by integration and classification
+#define GRAVITY 50.0f
+
+// Maximum ball speed enforced by integration for stability
+#define MAX_SPEED 500.0f
+
+// Balls resting on the floor below this speed are skipped by integration
+#define REST_SPEED 5.0f
+
+// ...once ground friction has also slowed their rolling below this speed
+#define REST_ROLL_SPEED 0.05f
+
+// Initial ball radii, picked uniformly by host and device placement
+#define BALL_SIZE_COUNT 3
+#define BALL_SIZES {15.0f, 20.0f, 25.0f}
+
+// Slots of the per-frame active lists in the active count buffer
+#define ACTIVE_MOVING 0     // Balls that need integration
+#define ACTIVE_CONTACT 1    // Balls with candidate ball-to-ball contacts
+#define ACTIVE_WALL 2       // Balls that may touch a wall this frame
+#define ACTIVE_PAIRS 3      // Overlapping ball pairs in the contact list
+#define ACTIVE_LIST_COUNT 4
+
+// Colouring rounds; contacts still uncoloured afterwards wait a frame
+#define MAX_CONTACT_COLOURS 32
+
+// Ball claims keep the contact's priority in the low bits and the claim epoch
+// above them, so a new round outbids every older claim without a clear
+#define CLAIM_PRIORITY_BITS 26
+#define CLAIM_EPOCHS (1 << (32 - CLAIM_PRIORITY_BITS))
+
 #endif // BALL_DEF_H
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 120
+
+varying vec3 colour;
+varying vec2 radiusPixels;
+varying float halfSize;
+
+void main() {
+    // Offset from the ball centre in pixels
+    vec2 offset = (gl_PointCoord * 2.0 - 1.0) * halfSize;
+
+    // Pixels past the edge of the ball's ellipse along the same direction,
+    // which is exact for circles, as with a square world and window
+    float distance = length(offset);
+    vec2 direction = distance > 0.0 ? offset / distance : vec2(1.0, 0.0);
+    float edge = distance - 1.0 / length(direction / radiusPixels);
+
+    // Coverage of the outer edge of the 2 pixel outline, antialiased over a pixel
+    float coverage = clamp(1.5 - edge, 0.0, 1.0);
+    if (coverage <= 0.0) discard;
+
+    // Fill at 0.9 alpha inside, the outline band opaque, as the mesh draws them
+    float outline = clamp(edge + 1.5, 0.0, 1.0);
+    gl_FragColor = vec4(colour, mix(0.9, 1.0, outline) * coverage);
+}
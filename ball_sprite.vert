@@ -0,0 +1,21 @@
+#version 120
+
+// One point per ball, sized to cover the disc, its outline and an
+// antialiasing margin; ball_sprite.frag shades the disc inside it
+attribute vec2 centre;
+attribute float radius;
+attribute float colourIndex;  // Ball index modulo 3
+
+uniform vec2 pixelsPerUnit;   // Framebuffer pixels per world unit along x and y
+
+varying vec3 colour;
+varying vec2 radiusPixels;    // Semi-axes of the ball on screen, in pixels
+varying float halfSize;       // Half the point size, in pixels
+
+void main() {
+    colour = vec3(float(colourIndex < 0.5), float(colourIndex > 0.5 && colourIndex < 1.5), float(colourIndex > 1.5));
+    radiusPixels = radius * pixelsPerUnit;
+    halfSize = max(radiusPixels.x, radiusPixels.y) + 2.0;
+    gl_PointSize = 2.0 * halfSize;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(centre, 0.0, 1.0);
+}
@@ -0,0 +1,512 @@
+// Headless benchmark sweeps over ball count, packing, radius distribution,
+// backend and contact solver (BallSimulationBench)
+// Every case sets up a fresh OpenCL pipeline, generates its balls from a fixed
+// seed, runs warm-up frames and then times a fixed number of frames. Results go
+// to stdout and, after every case, to the optional CSV and JSON files, so a
+// long sweep that is interrupted still leaves the cases it finished
+// With --baseline, the run is also a regression gate: throughput and mean
+// kernel times are compared with a stored baseline and the exit status is
+// non-zero if any case got slower than the tolerance allows or is missing from
+// the baseline
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "simulation.h"
+#include "sim_config.h"
+#include "placement.h"
+#include "event_sim.h"
+
+namespace {
+
+// Sweep axes and run lengths, set from the command line
+struct BenchOptions {
+    std::vector<int> sizes = {100, 1000, 10000, 100000, 1000000, 10000000};
+    std::vector<float> packings = {0.3f};
+    std::vector<std::string> radii = {"mixed"};
+    std::vector<std::string> backends = {"device"};
+    std::vector<std::string> solvers = {"coloured"};
+    int frames = 100;
+    int warmupFrames = 10;
+    float timeStep = 1.0f / 60.0f;
+    unsigned int seed = 1;
+    std::string csvPath;
+    std::string jsonPath;
+    std::string baselinePath;      // Baseline to gate against
+    std::string saveBaselinePath;  // Baseline to write from this run
+    double tolerance = 0.15;       // Allowed slowdown as a fraction of the baseline
+    bool allowMissing = false;     // Pass cases the baseline does not cover
+};
+
+// Kernels faster than this per step are too noisy to gate on
+const double KERNEL_GATE_FLOOR_MS = 0.02;
+
+// Measurements of one case
+struct BenchResult {
+    std::string backend, solver, radii;
+    int balls;
+    float packing;
+    float worldWidth, worldHeight;
+    int frames;
+    double seconds;
+    double stepsPerSecond;
+    double nsPerBallStep;
+    double contactsPerStep;   // Resolved collisions, or processed events on the event backend
+    size_t deviceBytes;       // Simulation buffers; 0 on the host event backend
+    std::map<std::string, double> kernelMs;  // Mean device time per step of each kernel
+};
+
+std::string deviceName;
+std::vector<BenchResult> results;
+
+// Prints supported options
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --sizes=N,...              Ball counts (default 1e2,1e3,...,1e7)\n"
+              << "  --packings=F,...           Packing fractions, at most 0.5 (default 0.3)\n"
+              << "  --radii=mixed|uniform|equal,...\n"
+              << "                             Radius distributions (default mixed)\n"
+              << "  --backends=device|event,...  Simulation backends (default device)\n"
+              << "  --solvers=coloured|jacobi|sequential,...\n"
+              << "                             Contact solvers of the device backend (default coloured)\n"
+              << "  --frames=N                 Timed frames per case (default 100)\n"
+              << "  --warmup=N                 Untimed frames before timing (default 10)\n"
+              << "  --timestep=S               Fixed time step in seconds (default 1/60)\n"
+              << "  --seed=N                   Seed of the initial states (default 1)\n"
+              << "  --csv=FILE                 Write results as CSV\n"
+              << "  --json=FILE                Write results as JSON\n"
+              << "  --gate                     Run the fixed regression scenes (options after it override)\n"
+              << "  --baseline=FILE            Compare with a baseline; exit 1 on regression\n"
+              << "  --save-baseline=FILE       Write this run as a baseline\n"
+              << "  --tolerance=F              Allowed slowdown fraction (default 0.15)\n"
+              << "  --allow-missing            Pass cases missing from the baseline\n"
+              << "  --help                     Show this message" << std::endl;
+}
+
+[[noreturn]] void invalidValue(const std::string& option, const std::string& value) {
+    std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+    exit(1);
+}
+
+// Splits a comma-separated option value
+std::vector<std::string> splitList(const std::string& value, const std::string& option) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        std::string item = value.substr(start, comma - start);
+        if (item.empty()) invalidValue(option, value);
+        items.push_back(item);
+        start = comma + 1;
+    }
+    return items;
+}
+
+// Parses a strictly positive number; counts may use exponents such as 1e6
+double parsePositive(const std::string& value, const std::string& option) {
+    char* end = nullptr;
+    double parsed = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !(parsed > 0.0)) invalidValue(option, value);
+    return parsed;
+}
+
+int parseCount(const std::string& value, const std::string& option) {
+    double parsed = parsePositive(value, option);
+    if (parsed != std::floor(parsed) || parsed > 2147483647.0) invalidValue(option, value);
+    return static_cast<int>(parsed);
+}
+
+// Checks every item of a list against the accepted names
+std::vector<std::string> parseNames(const std::string& value, const std::string& option,
+                                    const std::vector<std::string>& accepted) {
+    std::vector<std::string> names = splitList(value, option);
+    for (const std::string& name : names) {
+        if (std::find(accepted.begin(), accepted.end(), name) == accepted.end()) invalidValue(option, name);
+    }
+    return names;
+}
+
+BenchOptions parseBenchOptions(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string option = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+
+        if (option == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else if (option == "--gate") {
+            // Fixed deterministic scenes: small to mid sizes, sparse and dense,
+            // every solver, long enough runs to average out frame jitter
+            options.sizes = {1000, 10000, 100000};
+            options.packings = {0.1f, 0.4f};
+            options.radii = {"mixed"};
+            options.backends = {"device"};
+            options.solvers = {"coloured", "jacobi", "sequential"};
+            options.frames = 200;
+            options.warmupFrames = 20;
+            options.timeStep = 1.0f / 60.0f;
+            options.seed = 1;
+        } else if (option == "--sizes") {
+            options.sizes.clear();
+            for (const std::string& item : splitList(value, option)) {
+                options.sizes.push_back(parseCount(item, option));
+            }
+        } else if (option == "--packings") {
+            options.packings.clear();
+            for (const std::string& item : splitList(value, option)) {
+                float packing = static_cast<float>(parsePositive(item, option));
+                if (packing > 0.5f) invalidValue(option, item);
+                options.packings.push_back(packing);
+            }
+        } else if (option == "--radii") {
+            options.radii = parseNames(value, option, {"mixed", "uniform", "equal"});
+        } else if (option == "--backends") {
+            options.backends = parseNames(value, option, {"device", "event"});
+        } else if (option == "--solvers") {
+            options.solvers = parseNames(value, option, {"coloured", "jacobi", "sequential"});
+        } else if (option == "--frames") {
+            options.frames = parseCount(value, option);
+        } else if (option == "--warmup") {
+            options.warmupFrames = parseCount(value, option);
+        } else if (option == "--timestep") {
+            options.timeStep = static_cast<float>(parsePositive(value, option));
+        } else if (option == "--seed") {
+            options.seed = static_cast<unsigned int>(parseCount(value, option));
+        } else if (option == "--csv" || option == "--json" || option == "--baseline" ||
+                   option == "--save-baseline") {
+            if (value.empty()) {
+                std::cerr << "Missing file name for " << option << std::endl;
+                exit(1);
+            }
+            if (option == "--csv") options.csvPath = value;
+            if (option == "--json") options.jsonPath = value;
+            if (option == "--baseline") options.baselinePath = value;
+            if (option == "--save-baseline") options.saveBaselinePath = value;
+        } else if (option == "--tolerance") {
+            options.tolerance = parsePositive(value, option);
+        } else if (option == "--allow-missing") {
+            options.allowMissing = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            exit(1);
+        }
+    }
+    return options;
+}
+
+SolverMode solverMode(const std::string& name) {
+    if (name == "jacobi") return SolverMode::Jacobi;
+    if (name == "sequential") return SolverMode::Sequential;
+    return SolverMode::Coloured;
+}
+
+// Replaces the placement radii (15, 20 or 25) with another distribution
+// Radii stay within MAX_RADIUS, so balls still cannot overlap
+void reshapeRadii(const std::string& radii, std::mt19937& rng) {
+    if (radii == "mixed") return;
+
+    std::vector<Ball> balls(config.numBalls);
+    cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0, sizeof(Ball) * config.numBalls,
+                                      balls.data(), 0, nullptr, nullptr);
+    checkError(error, "reading benchmark balls");
+    std::uniform_real_distribution<float> radius(MIN_RADIUS, MAX_RADIUS);
+    for (Ball& ball : balls) {
+        ball.radius = radii == "uniform" ? radius(rng) : 0.5f * (MIN_RADIUS + MAX_RADIUS);
+    }
+    error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0, sizeof(Ball) * config.numBalls,
+                                 balls.data(), 0, nullptr, nullptr);
+    checkError(error, "writing benchmark balls");
+}
+
+// Steps the device pipeline once and returns the collisions it resolved
+// The blocking stats read also waits for the frame, as clFinish would
+int stepDevice(float deltaTime) {
+    simulateFrame(deltaTime);
+    cl_int collisions = 0;
+    cl_int error = clEnqueueReadBuffer(queue, statsBuffer, CL_TRUE, 0, sizeof(cl_int), &collisions,
+                                      0, nullptr, nullptr);
+    checkError(error, "reading collision count");
+    return collisions;
+}
+
+BenchResult runCase(const BenchOptions& options, const std::string& backend, const std::string& solver,
+                    const std::string& radii, float packing, int balls) {
+    config.numBalls = balls;
+    config.worldWidth = 800.0f;
+    config.worldHeight = 600.0f;
+    config.packingFraction = packing;
+    config.solver = solverMode(solver);
+    applyPackingFraction();
+
+    // Every case starts from the same seed, so cases differ only in their axes
+    std::mt19937 rng(options.seed);
+    initOpenCL(balls);
+    if (deviceName.empty()) {
+        char name[128];
+        clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, nullptr);
+        deviceName = name;
+    }
+    // Separate draws fix the order, which operands of | leave unspecified
+    cl_ulong high = rng();
+    cl_ulong low = rng();
+    generateBallsOnDevice((high << 32) | low);
+    reshapeRadii(radii, rng);
+
+    bool event = backend == "event";
+    if (event) {
+        std::vector<Ball> initial(balls);
+        cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0, sizeof(Ball) * balls,
+                                          initial.data(), 0, nullptr, nullptr);
+        checkError(error, "reading benchmark balls");
+        initEventSimulation(initial);
+    }
+
+    for (int frame = 0; frame < options.warmupFrames; frame++) {
+        if (event) {
+            advanceEventSimulation(options.timeStep);
+        } else {
+            stepDevice(options.timeStep);
+            takeKernelIntervals();
+        }
+    }
+    if (event) takeEventCount();
+
+    // Kernel intervals are collected every frame so their events do not pile up
+    long long contacts = 0;
+    std::map<std::string, double> kernelNs;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < options.frames; frame++) {
+        if (event) {
+            advanceEventSimulation(options.timeStep);
+        } else {
+            contacts += stepDevice(options.timeStep);
+            for (const KernelInterval& interval : takeKernelIntervals()) {
+                kernelNs[interval.name] += static_cast<double>(interval.end - interval.start);
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (event) contacts = takeEventCount();
+
+    BenchResult result;
+    result.backend = backend;
+    result.solver = event ? "none" : solver;
+    result.radii = radii;
+    result.balls = balls;
+    result.packing = packing;
+    result.worldWidth = config.worldWidth;
+    result.worldHeight = config.worldHeight;
+    result.frames = options.frames;
+    result.seconds = seconds;
+    result.stepsPerSecond = options.frames / seconds;
+    result.nsPerBallStep = seconds * 1.0e9 / (static_cast<double>(options.frames) * balls);
+    result.contactsPerStep = static_cast<double>(contacts) / options.frames;
+    result.deviceBytes = event ? 0 : simulationDeviceBytes();
+    for (const auto& kernel : kernelNs) {
+        result.kernelMs[kernel.first] = kernel.second * 1.0e-6 / options.frames;
+    }
+
+    cleanupOpenCL();
+    return result;
+}
+
+void writeCsv(const std::string& path) {
+    std::ofstream file(path);
+    file << "device,backend,solver,radii,balls,packing,world_width,world_height,frames,seconds,"
+         << "steps_per_second,ns_per_ball_step,contacts_per_step,device_bytes\n";
+    for (const BenchResult& r : results) {
+        file << '"' << deviceName << "\"," << r.backend << ',' << r.solver << ',' << r.radii << ','
+             << r.balls << ',' << r.packing << ',' << r.worldWidth << ',' << r.worldHeight << ','
+             << r.frames << ',' << r.seconds << ',' << r.stepsPerSecond << ',' << r.nsPerBallStep << ','
+             << r.contactsPerStep << ',' << r.deviceBytes << '\n';
+    }
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        exit(1);
+    }
+}
+
+void writeJson(const std::string& path) {
+    std::ofstream file(path);
+    file << "{\n  \"device\": \"" << deviceName << "\",\n  \"cases\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        file << (i ? ",\n" : "\n")
+             << "    {\"backend\": \"" << r.backend << "\", \"solver\": \"" << r.solver
+             << "\", \"radii\": \"" << r.radii << "\", \"balls\": " << r.balls
+             << ", \"packing\": " << r.packing << ", \"world_width\": " << r.worldWidth
+             << ", \"world_height\": " << r.worldHeight << ", \"frames\": " << r.frames
+             << ", \"seconds\": " << r.seconds << ", \"steps_per_second\": " << r.stepsPerSecond
+             << ", \"ns_per_ball_step\": " << r.nsPerBallStep
+             << ", \"contacts_per_step\": " << r.contactsPerStep
+             << ", \"device_bytes\": " << r.deviceBytes << ", \"kernel_ms\": {";
+        for (auto kernel = r.kernelMs.begin(); kernel != r.kernelMs.end(); ++kernel) {
+            file << (kernel == r.kernelMs.begin() ? "" : ", ") << '"' << kernel->first << "\": " << kernel->second;
+        }
+        file << "}}";
+    }
+    file << "\n  ]\n}\n";
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        exit(1);
+    }
+}
+
+// Baseline key of a case, e.g. device/coloured/mixed/10000/0.4
+std::string caseKey(const BenchResult& r) {
+    std::ostringstream key;
+    key << r.backend << '/' << r.solver << '/' << r.radii << '/' << r.balls << '/' << r.packing;
+    return key.str();
+}
+
+// Baseline file: a comment line naming the device, then one
+// "case metric value" line per throughput and kernel time
+void writeBaseline(const std::string& path) {
+    std::ofstream file(path);
+    file << "# BallSimulationBench baseline on " << deviceName << '\n';
+    for (const BenchResult& r : results) {
+        file << caseKey(r) << " steps_per_second " << r.stepsPerSecond << '\n';
+        for (const auto& kernel : r.kernelMs) {
+            file << caseKey(r) << " kernel_ms:" << kernel.first << ' ' << kernel.second << '\n';
+        }
+    }
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        exit(1);
+    }
+}
+
+// Reads a baseline into "case metric" -> value
+std::map<std::string, double> readBaseline(const std::string& path, std::string& baselineDevice) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open baseline " << path << std::endl;
+        exit(1);
+    }
+    std::map<std::string, double> baseline;
+    const std::string devicePrefix = "# BallSimulationBench baseline on ";
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, devicePrefix.size(), devicePrefix) == 0) {
+            baselineDevice = line.substr(devicePrefix.size());
+        }
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string key, metric;
+        double value;
+        if (!(fields >> key >> metric >> value)) {
+            std::cerr << "Malformed baseline line in " << path << ": " << line << std::endl;
+            exit(1);
+        }
+        baseline[key + ' ' + metric] = value;
+    }
+    return baseline;
+}
+
+// Reports every metric outside the tolerance; returns true if any regressed
+// Throughput regresses when it drops, kernel times when they grow. A case
+// without baseline throughput, or a run with nothing compared, also fails
+// unless --allow-missing is given
+bool compareWithBaseline(const BenchOptions& options) {
+    std::string baselineDevice;
+    std::map<std::string, double> baseline = readBaseline(options.baselinePath, baselineDevice);
+    if (baselineDevice != deviceName) {
+        std::cout << "Warning: baseline was recorded on " << baselineDevice << ", not " << deviceName << std::endl;
+    }
+
+    int regressions = 0, compared = 0, missing = 0, missingCases = 0;
+    auto check = [&](const std::string& key, const std::string& metric, double current, bool higherIsBetter) {
+        auto found = baseline.find(key + ' ' + metric);
+        if (found == baseline.end()) {
+            missing++;
+            return false;
+        }
+        double reference = found->second;
+        if (!higherIsBetter && reference < KERNEL_GATE_FLOOR_MS) return true;
+        compared++;
+        double change = (current - reference) / reference;
+        bool regressed = higherIsBetter ? change < -options.tolerance : change > options.tolerance;
+        if (regressed) {
+            regressions++;
+            std::cout << "REGRESSION " << key << ' ' << metric << ": " << reference << " -> " << current
+                      << " (" << (change > 0 ? "+" : "") << 100.0 * change << "%)" << std::endl;
+        }
+        return true;
+    };
+    for (const BenchResult& r : results) {
+        std::string key = caseKey(r);
+        if (!check(key, "steps_per_second", r.stepsPerSecond, true)) {
+            missingCases++;
+            std::cout << (options.allowMissing ? "NOT IN BASELINE " : "MISSING ") << key << std::endl;
+        }
+        for (const auto& kernel : r.kernelMs) {
+            check(key, "kernel_ms:" + kernel.first, kernel.second, false);
+        }
+    }
+
+    std::cout << "Baseline comparison: " << compared << " metrics within " << 100.0 * options.tolerance
+              << "% tolerance checked, " << regressions << " regressed";
+    if (missing > 0) {
+        std::cout << ", " << missing << " not in the baseline";
+    }
+    std::cout << std::endl;
+    if (options.allowMissing) return regressions > 0;
+    if (compared == 0) {
+        std::cout << "No metrics matched the baseline; pass --allow-missing to accept this" << std::endl;
+    } else if (missingCases > 0) {
+        std::cout << missingCases << " cases have no baseline throughput; pass --allow-missing to accept this"
+                  << std::endl;
+    }
+    return regressions > 0 || compared == 0 || missingCases > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options = parseBenchOptions(argc, argv);
+    config.profileKernels = true;
+
+    for (const std::string& backend : options.backends) {
+        // The event backend has no contact solver, so it runs once per case
+        std::vector<std::string> solvers = backend == "event" ? std::vector<std::string>{"none"} : options.solvers;
+        for (const std::string& solver : solvers) {
+            for (const std::string& radii : options.radii) {
+                for (float packing : options.packings) {
+                    for (int balls : options.sizes) {
+                        BenchResult r = runCase(options, backend, solver, radii, packing, balls);
+                        results.push_back(r);
+                        std::cout << r.backend << " " << r.solver << " " << r.radii << " N=" << r.balls
+                                  << " packing=" << r.packing << ": " << r.stepsPerSecond << " steps/s, "
+                                  << r.nsPerBallStep << " ns/ball/step, " << r.contactsPerStep
+                                  << " contacts/step, " << r.deviceBytes / (1024.0 * 1024.0) << " MiB"
+                                  << std::endl;
+
+                        if (!options.csvPath.empty()) writeCsv(options.csvPath);
+                        if (!options.jsonPath.empty()) writeJson(options.jsonPath);
+                    }
+                }
+            }
+        }
+    }
+
+    if (!options.saveBaselinePath.empty()) {
+        writeBaseline(options.saveBaselinePath);
+    }
+    if (!options.baselinePath.empty() && compareWithBaseline(options)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include "checkpoint.h"
+#include "simulation.h"
+#include "sim_config.h"
+#include "trace.h"
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'B', 'A', 'L', 'L', 'C', 'K', 'P', 'T'};
+
+// Snapshot in flight: filled by the device, then written by the writer thread
+struct CheckpointJob {
+    std::string path;
+    SimConfig settings;
+    double simulationTime;
+    std::string rngState;
+    std::vector<Ball> balls;
+    cl_event readEvent;
+};
+
+std::thread writerThread;
+std::mutex writerMutex;
+std::condition_variable writerWake;
+CheckpointJob* pendingJob = nullptr;  // Owned by the writer once queued
+bool writerBusy = false;
+bool writerStopping = false;
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readValue(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// Writes to a temporary file and renames it, so an interrupted write
+// never replaces the last good checkpoint
+void writeCheckpoint(const CheckpointJob& job) {
+    std::string temporaryPath = job.path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open checkpoint file: " << temporaryPath << std::endl;
+        return;
+    }
+
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeValue(out, CHECKPOINT_VERSION);
+    writeValue(out, static_cast<unsigned int>(sizeof(Ball)));
+
+    writeValue(out, job.settings.numBalls);
+    writeValue(out, job.settings.worldWidth);
+    writeValue(out, job.settings.worldHeight);
+    writeValue(out, static_cast<int>(job.settings.solver));
+    writeValue(out, job.settings.solverIterations);
+    writeValue(out, job.settings.relaxation);
+    writeValue(out, job.settings.maxTimeStep);
+    writeValue(out, static_cast<char>(job.settings.continuousCollisions));
+    writeValue(out, static_cast<char>(job.settings.eventDriven));
+
+    writeValue(out, job.simulationTime);
+    writeValue(out, static_cast<unsigned int>(job.rngState.size()));
+    out.write(job.rngState.data(), job.rngState.size());
+    out.write(reinterpret_cast<const char*>(job.balls.data()), sizeof(Ball) * job.balls.size());
+    out.close();
+
+    if (!out || std::rename(temporaryPath.c_str(), job.path.c_str()) != 0) {
+        std::cerr << "Failed to write checkpoint file: " << job.path << std::endl;
+    }
+}
+
+// Writer thread: waits for the device readback, then writes the file
+void writerLoop() {
+    nameTraceThread("Checkpoint writer");
+    std::unique_lock<std::mutex> lock(writerMutex);
+    while (true) {
+        writerWake.wait(lock, [] { return pendingJob != nullptr || writerStopping; });
+        if (!pendingJob) break;
+
+        CheckpointJob* job = pendingJob;
+        pendingJob = nullptr;
+        lock.unlock();
+
+        cl_int error;
+        {
+            TraceSpan span("wait for checkpoint readback");
+            error = clWaitForEvents(1, &job->readEvent);
+        }
+        clReleaseEvent(job->readEvent);
+        if (error == CL_SUCCESS) {
+            TraceSpan span("write checkpoint");
+            writeCheckpoint(*job);
+        } else {
+            std::cerr << "Checkpoint readback failed with error " << error << std::endl;
+        }
+        delete job;
+
+        lock.lock();
+        writerBusy = false;
+        writerWake.notify_all();
+    }
+}
+
+}  // namespace
+
+void startCheckpointWriter() {
+    writerStopping = false;
+    writerThread = std::thread(writerLoop);
+}
+
+void requestCheckpoint(const std::string& path, double simulationTime, const std::mt19937& rng,
+                       bool waitForWriter) {
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        if (waitForWriter) {
+            writerWake.wait(lock, [] { return !writerBusy; });
+        } else if (writerBusy) {
+            return;
+        }
+        writerBusy = true;
+    }
+
+    CheckpointJob* job = new CheckpointJob();
+    job->path = path;
+    job->settings = config;
+    job->simulationTime = simulationTime;
+    std::ostringstream rngState;
+    rngState << rng;
+    job->rngState = rngState.str();
+    job->balls.resize(config.numBalls);
+
+    // Non-blocking readback; the in-order queue keeps later frames from
+    // overwriting ballBuffer before the copy completes
+    cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_FALSE, 0,
+                                       sizeof(Ball) * config.numBalls, job->balls.data(),
+                                       0, nullptr, &job->readEvent);
+    checkError(error, "reading ball data for checkpoint");
+    clFlush(queue);
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+    pendingJob = job;
+    writerWake.notify_all();
+}
+
+void stopCheckpointWriter() {
+    if (!writerThread.joinable()) return;
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        writerWake.wait(lock, [] { return !writerBusy; });
+        writerStopping = true;
+        writerWake.notify_all();
+    }
+    writerThread.join();
+}
+
+void loadCheckpoint(const std::string& path, std::vector<Ball>& balls,
+                    double& simulationTime, std::mt19937& rng) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Failed to open checkpoint file: " << path << std::endl;
+        exit(1);
+    }
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    unsigned int version = 0, ballSize = 0;
+    in.read(magic, sizeof(magic));
+    readValue(in, version);
+    readValue(in, ballSize);
+    if (!in || std::string(magic, sizeof(magic)) != std::string(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))) {
+        std::cerr << "Not a checkpoint file: " << path << std::endl;
+        exit(1);
+    }
+    if (version != CHECKPOINT_VERSION || ballSize != sizeof(Ball)) {
+        std::cerr << "Unsupported checkpoint version " << version << " in " << path << std::endl;
+        exit(1);
+    }
+
+    // Ball count and world size define the state; solver settings are kept
+    // from the command line so a restored run can be continued differently
+    SimConfig saved;
+    int solver;
+    char continuousCollisions, eventDriven;
+    readValue(in, saved.numBalls);
+    readValue(in, saved.worldWidth);
+    readValue(in, saved.worldHeight);
+    readValue(in, solver);
+    readValue(in, saved.solverIterations);
+    readValue(in, saved.relaxation);
+    readValue(in, saved.maxTimeStep);
+    readValue(in, continuousCollisions);
+    readValue(in, eventDriven);
+    if (!in || saved.numBalls <= 0) {
+        std::cerr << "Invalid checkpoint header in " << path << std::endl;
+        exit(1);
+    }
+    config.numBalls = saved.numBalls;
+    config.worldWidth = saved.worldWidth;
+    config.worldHeight = saved.worldHeight;
+
+    unsigned int rngLength = 0;
+    readValue(in, simulationTime);
+    readValue(in, rngLength);
+    std::string rngState(rngLength, '\0');
+    in.read(&rngState[0], rngLength);
+    std::istringstream(rngState) >> rng;
+
+    balls.resize(config.numBalls);
+    in.read(reinterpret_cast<char*>(balls.data()), sizeof(Ball) * balls.size());
+    if (!in) {
+        std::cerr << "Truncated checkpoint file: " << path << std::endl;
+        exit(1);
+    }
+
+    std::cout << "Restored " << config.numBalls << " balls at t=" << simulationTime
+              << " from " << path << std::endl;
+}
@@ -0,0 +1,31 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <random>
+#include <string>
+#include <vector>
+#include "ball_def.h"
+
+// Binary checkpoints of the full simulation state
+// Layout (native byte order): "BALLCKPT", format version, sizeof(Ball),
+// configuration, simulation time, serialized RNG state, then the Ball array
+
+const unsigned int CHECKPOINT_VERSION = 1;
+
+// Starts the background thread that writes checkpoint files
+void startCheckpointWriter();
+
+// Enqueues a non-blocking readback of ballBuffer and hands it to the writer
+// Skipped if the previous checkpoint is still being written, unless waitForWriter
+void requestCheckpoint(const std::string& path, double simulationTime, const std::mt19937& rng,
+                       bool waitForWriter);
+
+// Waits for pending checkpoints and stops the writer thread
+void stopCheckpointWriter();
+
+// Reads a checkpoint, applying its ball count and world size to config
+// Must run before initOpenCL so buffers are sized for the restored state
+void loadCheckpoint(const std::string& path, std::vector<Ball>& balls,
+                    double& simulationTime, std::mt19937& rng);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,196 @@
+#include "ball_def.h"
+
+// Kernels that build the per-frame active lists
+// Each list is a flag array turned into a sorted index list by an
+// exclusive prefix sum followed by a scatter (stream compaction)
+
+// Maps a position to its cell in the uniform broad-phase grid
+int cellIndexOf(FLOAT2 position, const float cellSize, const int gridWidth, const int gridHeight) {
+    int cx = clamp((int)(position.x / cellSize), 0, gridWidth - 1);
+    int cy = clamp((int)(position.y / cellSize), 0, gridHeight - 1);
+    return cy * gridWidth + cx;
+}
+
+// Flags balls that need integration and balls that may reach a wall this frame
+// Also records step-start positions for swept contact tests
+__kernel void classifyMotion(
+    __global const Ball* balls,    // Array of all balls in simulation
+    const int numBalls,            // Total number of balls
+    const float deltaTime,         // Time step for physics update
+    const FLOAT2 boundaries,       // Window boundaries (width, height)
+    __global int* movingFlags,     // 1 if ball needs integration
+    __global int* wallFlags,       // 1 if ball may touch a wall
+    __global FLOAT2* previousPositions // Positions at step start
+) {
+    int gid = get_global_id(0);
+    if (gid >= numBalls) return;
+
+    Ball ball = balls[gid];
+    previousPositions[gid] = ball.position;
+    float speed = sqrt(ball.velocity.x * ball.velocity.x + ball.velocity.y * ball.velocity.y);
+
+    // Balls settled on the floor sleep until a contact wakes them up; slow
+    // rollers keep moving while ground friction brings them to a stop
+    float floorGap = boundaries.y - ball.radius - ball.position.y;
+    bool resting = floorGap < 1.0f && speed < REST_SPEED && fabs(ball.velocity.x) < REST_ROLL_SPEED;
+    movingFlags[gid] = resting ? 0 : 1;
+
+    // Conservative travel bound for this step, plus the ground friction band
+    float reach = ball.radius + (speed + GRAVITY * deltaTime) * deltaTime + 1.0f;
+    bool nearWall = ball.position.x < reach
+                 || ball.position.y < reach
+                 || boundaries.x - ball.position.x < reach
+                 || boundaries.y - ball.position.y < reach;
+    wallFlags[gid] = nearWall ? 1 : 0;
+}
+
+// Counts balls per broad-phase grid cell
+__kernel void countCellOccupancy(
+    __global const Ball* balls,    // Array of all balls in simulation
+    const int numBalls,            // Total number of balls
+    const float cellSize,          // Grid cell edge, at least one max diameter
+    const int gridWidth,           // Number of cells along x
+    const int gridHeight,          // Number of cells along y
+    __global int* cellCounts       // Balls per cell, cleared by the host
+) {
+    int gid = get_global_id(0);
+    if (gid >= numBalls) return;
+
+    int cell = cellIndexOf(balls[gid].position, cellSize, gridWidth, gridHeight);
+    atomic_inc(&cellCounts[cell]);
+}
+
+// Writes ball indices into cell order using the scanned cell counts as cursors
+__kernel void binBallsByCell(
+    __global const Ball* balls,    // Array of all balls in simulation
+    const int numBalls,            // Total number of balls
+    const float cellSize,          // Grid cell edge, at least one max diameter
+    const int gridWidth,           // Number of cells along x
+    const int gridHeight,          // Number of cells along y
+    __global int* cellCursor,      // Next free sorted slot per cell
+    __global int* sortedBalls      // Ball indices ordered by cell
+) {
+    int gid = get_global_id(0);
+    if (gid >= numBalls) return;
+
+    int cell = cellIndexOf(balls[gid].position, cellSize, gridWidth, gridHeight);
+    sortedBalls[atomic_inc(&cellCursor[cell])] = gid;
+}
+
+// Flags balls that share their cell neighbourhood with another ball
+// The neighbourhood is 3x3 cells, or wider when swept contacts are tested
+__kernel void classifyContacts(
+    __global const Ball* balls,    // Array of all balls in simulation
+    const int numBalls,            // Total number of balls
+    const float cellSize,          // Grid cell edge, at least one max diameter
+    const int gridWidth,           // Number of cells along x
+    const int gridHeight,          // Number of cells along y
+    const int searchCells,         // Neighbourhood radius in cells
+    __global const int* cellCounts,// Balls per cell
+    __global int* contactFlags     // 1 if ball has candidate contacts
+) {
+    int gid = get_global_id(0);
+    if (gid >= numBalls) return;
+
+    FLOAT2 position = balls[gid].position;
+    int cx = clamp((int)(position.x / cellSize), 0, gridWidth - 1);
+    int cy = clamp((int)(position.y / cellSize), 0, gridHeight - 1);
+
+    // Count neighbours, excluding this ball itself
+    int neighbours = -1;
+    for (int y = max(cy - searchCells, 0); y <= min(cy + searchCells, gridHeight - 1); y++) {
+        for (int x = max(cx - searchCells, 0); x <= min(cx + searchCells, gridWidth - 1); x++) {
+            neighbours += cellCounts[y * gridWidth + x];
+        }
+    }
+    contactFlags[gid] = neighbours > 0 ? 1 : 0;
+}
+
+// Exclusive prefix sum of one block of 2 * local size elements (Blelloch scan)
+// Writes each block's total to blockSums for the next scan level
+__kernel void scanBlocks(
+    __global const int* input,     // Values to scan
+    __global int* output,          // Exclusive prefix sums (may alias input)
+    __global int* blockSums,       // Total of each block
+    const int n,                   // Number of values
+    __local int* temp              // Scratch of 2 * local size ints
+) {
+    int lid = get_local_id(0);
+    int groupSize = get_local_size(0);
+    int blockSize = groupSize * 2;
+    int blockStart = get_group_id(0) * blockSize;
+
+    // Load two elements per work-item, padding past the end with zeros
+    int ai = lid;
+    int bi = lid + groupSize;
+    temp[ai] = (blockStart + ai < n) ? input[blockStart + ai] : 0;
+    temp[bi] = (blockStart + bi < n) ? input[blockStart + bi] : 0;
+
+    // Up-sweep: build partial sums in place
+    int offset = 1;
+    for (int d = groupSize; d > 0; d >>= 1) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < d) {
+            int a = offset * (2 * lid + 1) - 1;
+            int b = offset * (2 * lid + 2) - 1;
+            temp[b] += temp[a];
+        }
+        offset <<= 1;
+    }
+
+    // Record block total and clear the root
+    if (lid == 0) {
+        blockSums[get_group_id(0)] = temp[blockSize - 1];
+        temp[blockSize - 1] = 0;
+    }
+
+    // Down-sweep: distribute partial sums
+    for (int d = 1; d < blockSize; d <<= 1) {
+        offset >>= 1;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < d) {
+            int a = offset * (2 * lid + 1) - 1;
+            int b = offset * (2 * lid + 2) - 1;
+            int t = temp[a];
+            temp[a] = temp[b];
+            temp[b] += t;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (blockStart + ai < n) output[blockStart + ai] = temp[ai];
+    if (blockStart + bi < n) output[blockStart + bi] = temp[bi];
+}
+
+// Adds the scanned block totals back onto each block
+__kernel void addBlockOffsets(
+    __global int* output,              // Per-block exclusive prefix sums
+    __global const int* blockOffsets,  // Exclusive prefix sums of block totals
+    const int n,                       // Number of values
+    const int blockSize                // Elements per scanned block
+) {
+    int gid = get_global_id(0);
+    if (gid >= n) return;
+    output[gid] += blockOffsets[gid / blockSize];
+}
+
+// Writes the index of every flagged element to its scanned slot
+// The last work-item also publishes the list size for indirect-style dispatch
+__kernel void scatterActive(
+    __global const int* flags,     // 1 if element is active
+    __global const int* offsets,   // Exclusive prefix sums of flags
+    const int n,                   // Number of elements
+    __global int* activeList,      // Compacted indices, sorted ascending
+    __global int* activeCounts,    // Active list sizes
+    const int slot                 // Which active list this is
+) {
+    int gid = get_global_id(0);
+    if (gid >= n) return;
+
+    if (flags[gid]) {
+        activeList[offsets[gid]] = gid;
+    }
+    if (gid == n - 1) {
+        activeCounts[slot] = offsets[gid] + flags[gid];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "ball_def.h"
+
+// Kernels that build, colour and solve the ball-to-ball contact list
+// Contacts of one colour touch disjoint balls, so a colour can be solved
+// fully in parallel without atomics on ball state
+
+// Resolves one contact with the impulse model of checkBallCollisions
+// Reads current positions, so earlier colours are seen (Gauss-Seidel)
+// Swept contacts are resolved where the balls first touched, then the
+// velocity change is carried through the rewound part of the step
+// Returns 1 if an impulse was applied
+int resolveContact(__global Ball* balls, Contact contact) {
+    Ball ball1 = balls[contact.a];
+    Ball ball2 = balls[contact.b];
+    float rewind = contact.rewind;
+
+    // Calculate center-to-center vector, rewound along the velocities
+    float dx = (ball2.position.x - ball2.velocity.x * rewind) - (ball1.position.x - ball1.velocity.x * rewind);
+    float dy = (ball2.position.y - ball2.velocity.y * rewind) - (ball1.position.y - ball1.velocity.y * rewind);
+    float distance = sqrt(dx * dx + dy * dy);
+
+    // Earlier colours may already have separated an overlapping pair
+    float minDist = ball1.radius + ball2.radius;
+    if (distance <= 0.0f) return 0;
+    if (rewind == 0.0f && distance >= minDist) return 0;
+
+    // Calculate normalized collision normal
+    float nx = dx / distance;
+    float ny = dy / distance;
+
+    // Project relative velocity onto collision normal
+    float dvx = ball2.velocity.x - ball1.velocity.x;
+    float dvy = ball2.velocity.y - ball1.velocity.y;
+    float relativeVelocity = dvx * nx + dvy * ny;
+
+    // Only process collision if balls are moving toward each other
+    if (relativeVelocity >= 0) return 0;
+
+    // Collision elasticity (30% energy loss)
+    float restitution = 0.7f;
+
+    // Calculate mass based on ball area
+    float mass1 = ball1.radius * ball1.radius;
+    float mass2 = ball2.radius * ball2.radius;
+    float totalMass = mass1 + mass2;
+
+    // Calculate collision impulse and apply it proportional to mass
+    float j = -(1.0f + restitution) * relativeVelocity * (mass1 * mass2 / totalMass);
+    float dv1x = -j * nx / mass1;
+    float dv1y = -j * ny / mass1;
+    float dv2x = j * nx / mass2;
+    float dv2y = j * ny / mass2;
+    ball1.velocity.x += dv1x;
+    ball1.velocity.y += dv1y;
+    ball2.velocity.x += dv2x;
+    ball2.velocity.y += dv2y;
+
+    // Apply collision friction (2% energy loss)
+    ball1.velocity.x *= 0.98f;
+    ball1.velocity.y *= 0.98f;
+    ball2.velocity.x *= 0.98f;
+    ball2.velocity.y *= 0.98f;
+
+    // Move swept balls along their new velocity for the rewound time
+    ball1.position.x += dv1x * rewind;
+    ball1.position.y += dv1y * rewind;
+    ball2.position.x += dv2x * rewind;
+    ball2.position.y += dv2y * rewind;
+
+    // Resolve 80% of any remaining overlap, separating proportional to masses
+    float overlap = max(minDist - distance, 0.0f) * 0.8f;
+    ball1.position.x -= nx * overlap * mass2 / totalMass;
+    ball1.position.y -= ny * overlap * mass2 / totalMass;
+    ball2.position.x += nx * overlap * mass1 / totalMass;
+    ball2.position.y += ny * overlap * mass1 / totalMass;
+
+    balls[contact.a] = ball1;
+    balls[contact.b] = ball2;
+    return 1;
+}
+
+// Swept-circle time of impact over the step, as a fraction in [0, 1]
+// Centers move linearly from the start positions (d0 apart) to the end
+// positions (d1 apart); returns -1 if the circles never touch
+float sweptImpactFraction(float2 d0, float2 d1, float minDist) {
+    float2 e = d1 - d0;
+    float a = dot(e, e);
+    float b = 2.0f * dot(d0, e);
+    float c = dot(d0, d0) - minDist * minDist;
+    if (a <= 0.0f || b >= 0.0f) return -1.0f;     // Not approaching
+    float disc = b * b - 4.0f * a * c;
+    if (disc < 0.0f) return -1.0f;                // Closest approach misses
+    float s = (-b - sqrt(disc)) / (2.0f * a);
+    return (s >= 0.0f && s <= 1.0f) ? s : -1.0f;
+}
+
+// Appends every overlapping pair (i < j) around the candidate balls
+// With continuous collisions, pairs whose swept paths touched during the
+// step are appended too, with the time to rewind to their first touch
+// Uses the cell-sorted ball order from binBallsByCell
+__kernel void findContacts(
+    __global const Ball* balls,                 // Array of all balls in simulation
+    __global const int* contactList,            // Indices of balls with candidate contacts
+    __global int* activeCounts,                 // Active list sizes; pair count is appended
+    __global const int* cellStart,              // First sorted slot of each cell
+    __global const int* cellCounts,             // Balls per cell
+    __global const int* sortedBalls,            // Ball indices ordered by cell
+    const float cellSize,                       // Grid cell edge, at least one max diameter
+    const int gridWidth,                        // Number of cells along x
+    const int gridHeight,                       // Number of cells along y
+    const int searchCells,                      // Neighbourhood radius in cells
+    __global const FLOAT2* previousPositions,   // Positions at step start
+    const int sweptContacts,                    // 1 to test swept paths
+    const float deltaTime,                      // Time step for physics update
+    __global Contact* contacts,                 // Output contact pairs
+    const int maxContacts                       // Contact list capacity
+) {
+    int count = activeCounts[ACTIVE_CONTACT];
+
+    for (int k = get_global_id(0); k < count; k += get_global_size(0)) {
+        int i = contactList[k];
+        Ball ball1 = balls[i];
+        int cx = clamp((int)(ball1.position.x / cellSize), 0, gridWidth - 1);
+        int cy = clamp((int)(ball1.position.y / cellSize), 0, gridHeight - 1);
+
+        for (int y = max(cy - searchCells, 0); y <= min(cy + searchCells, gridHeight - 1); y++) {
+            for (int x = max(cx - searchCells, 0); x <= min(cx + searchCells, gridWidth - 1); x++) {
+                int cell = y * gridWidth + x;
+                int end = cellStart[cell] + cellCounts[cell];
+                for (int s = cellStart[cell]; s < end; s++) {
+                    int j = sortedBalls[s];
+                    if (j <= i) continue;
+
+                    Ball ball2 = balls[j];
+                    float2 d1 = ball2.position - ball1.position;
+                    float distSq = dot(d1, d1);
+                    float minDist = ball1.radius + ball2.radius;
+
+                    float rewind = -1.0f;
+                    if (distSq < minDist * minDist && distSq > 0.0f) {
+                        rewind = 0.0f;
+                    } else if (sweptContacts) {
+                        // Pair may have tunnelled through each other this step
+                        float2 d0 = previousPositions[j] - previousPositions[i];
+                        float impact = sweptImpactFraction(d0, d1, minDist);
+                        if (impact >= 0.0f) rewind = (1.0f - impact) * deltaTime;
+                    }
+
+                    if (rewind >= 0.0f) {
+                        // Pairs past capacity are dropped; the count still records them
+                        int slot = atomic_inc(&activeCounts[ACTIVE_PAIRS]);
+                        if (slot < maxContacts) {
+                            Contact contact = {i, j, rewind, 0};
+                            contacts[slot] = contact;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Per-round contact priority; a bijection on contact ids so no two
+// contacts ever tie when claiming a ball
+uint contactPriority(int contact, int round) {
+    return ((uint)contact ^ ((uint)round * 0x85EBCA6Bu)) * 0x9E3779B1u;
+}
+
+// Ball claim of a contact in one round; the epoch counts rounds across frames
+// and the low bits stay a bijection on contact ids below 2^CLAIM_PRIORITY_BITS
+uint contactClaim(int contact, int round, uint epoch) {
+    return (epoch << CLAIM_PRIORITY_BITS) | (contactPriority(contact, round) & ((1u << CLAIM_PRIORITY_BITS) - 1));
+}
+
+// Each uncoloured contact bids for both of its balls
+// Claims of earlier epochs are always lower, so ballClaims needs no clear
+__kernel void claimContactBalls(
+    __global const Contact* contacts,  // Contact pairs
+    __global const int* activeCounts,  // Active list sizes
+    const int maxContacts,             // Contact list capacity
+    __global const int* colours,       // Contact colour, -1 if uncoloured
+    __global uint* ballClaims,         // Highest bidding claim per ball
+    const int round,                   // Colouring round, also the colour assigned
+    const uint epoch                   // Claim epoch of this round
+) {
+    int count = min(activeCounts[ACTIVE_PAIRS], maxContacts);
+
+    for (int c = get_global_id(0); c < count; c += get_global_size(0)) {
+        if (colours[c] >= 0) continue;
+        uint claim = contactClaim(c, round, epoch);
+        Contact contact = contacts[c];
+        atomic_max(&ballClaims[contact.a], claim);
+        atomic_max(&ballClaims[contact.b], claim);
+    }
+}
+
+// Contacts that won both of their balls take this round's colour
+__kernel void assignContactColours(
+    __global const Contact* contacts,  // Contact pairs
+    __global const int* activeCounts,  // Active list sizes
+    const int maxContacts,             // Contact list capacity
+    __global int* colours,             // Contact colour, -1 if uncoloured
+    __global const uint* ballClaims,   // Highest bidding claim per ball
+    const int round,                   // Colouring round, also the colour assigned
+    __global int* colourCounts,        // Contacts per colour
+    const uint epoch                   // Claim epoch of this round
+) {
+    int count = min(activeCounts[ACTIVE_PAIRS], maxContacts);
+
+    for (int c = get_global_id(0); c < count; c += get_global_size(0)) {
+        if (colours[c] >= 0) continue;
+        uint claim = contactClaim(c, round, epoch);
+        Contact contact = contacts[c];
+        if (ballClaims[contact.a] == claim && ballClaims[contact.b] == claim) {
+            colours[c] = round;
+            atomic_inc(&colourCounts[round]);
+        }
+    }
+}
+
+// Groups contacts by colour using the scanned colour counts as cursors
+__kernel void sortContactsByColour(
+    __global const Contact* contacts,  // Contact pairs
+    __global const int* activeCounts,  // Active list sizes
+    const int maxContacts,             // Contact list capacity
+    __global const int* colours,       // Contact colour, -1 if uncoloured
+    __global int* colourCursor,        // Next free slot per colour
+    __global Contact* colouredContacts // Contacts grouped by colour
+) {
+    int count = min(activeCounts[ACTIVE_PAIRS], maxContacts);
+
+    for (int c = get_global_id(0); c < count; c += get_global_size(0)) {
+        int colour = colours[c];
+        if (colour < 0) continue;
+        int slot = atomic_inc(&colourCursor[colour]);
+        colouredContacts[slot] = contacts[c];
+    }
+}
+
+// Solves every contact of one colour; no two touch the same ball
+__kernel void solveContactColour(
+    __global Ball* balls,                       // Array of all balls in simulation
+    __global const Contact* colouredContacts,   // Contacts grouped by colour
+    __global const int* colourOffsets,          // First slot of each colour
+    __global const int* colourCounts,           // Contacts per colour
+    const int colour,                           // Colour solved by this launch
+    __global int* collisionCount                // Counter for collisions this frame
+) {
+    int start = colourOffsets[colour];
+    int end = start + colourCounts[colour];
+
+    int collisions = 0;
+    for (int c = start + get_global_id(0); c < end; c += get_global_size(0)) {
+        collisions += resolveContact(balls, colouredContacts[c]);
+    }
+    if (collisions > 0) {
+        atomic_add(collisionCount, collisions);
+    }
+}
+
+// Float atomic add built on 32-bit compare-and-swap (OpenCL 1.2 has no
+// native float atomics)
+void atomicAddFloat(volatile __global float* address, float value) {
+    union { unsigned int u; float f; } expected, desired;
+    do {
+        expected.f = *address;
+        desired.f = expected.f + value;
+    } while (atomic_cmpxchg((volatile __global unsigned int*)address, expected.u, desired.u) != expected.u);
+}
+
+// Jacobi pass: every contact computes its impulse and separation from the
+// previous iteration's state and scatter-adds them into per-ball deltas
+// Deltas hold (velocity.x, velocity.y, position.x, position.y) per ball
+__kernel void accumulateContactImpulses(
+    __global const Ball* balls,        // Array of all balls in simulation
+    __global const Contact* contacts,  // Contact pairs
+    __global const int* activeCounts,  // Active list sizes
+    const int maxContacts,             // Contact list capacity
+    __global float* ballDeltas,        // Accumulated per-ball corrections
+    __global int* ballContactCounts,   // Impulses applied per ball
+    __global int* collisionCount       // Counter for collisions this frame
+) {
+    int count = min(activeCounts[ACTIVE_PAIRS], maxContacts);
+
+    int collisions = 0;
+    for (int c = get_global_id(0); c < count; c += get_global_size(0)) {
+        Contact contact = contacts[c];
+        Ball ball1 = balls[contact.a];
+        Ball ball2 = balls[contact.b];
+        float rewind = contact.rewind;
+
+        // Swept contacts are evaluated where the balls first touched
+        float dx = (ball2.position.x - ball2.velocity.x * rewind) - (ball1.position.x - ball1.velocity.x * rewind);
+        float dy = (ball2.position.y - ball2.velocity.y * rewind) - (ball1.position.y - ball1.velocity.y * rewind);
+        float distance = sqrt(dx * dx + dy * dy);
+        float minDist = ball1.radius + ball2.radius;
+        if (distance <= 0.0f) continue;
+        if (rewind == 0.0f && distance >= minDist) continue;
+
+        float nx = dx / distance;
+        float ny = dy / distance;
+        float dvx = ball2.velocity.x - ball1.velocity.x;
+        float dvy = ball2.velocity.y - ball1.velocity.y;
+        float relativeVelocity = dvx * nx + dvy * ny;
+        if (relativeVelocity >= 0) continue;
+
+        // Same impulse and separation model as resolveContact
+        float restitution = 0.7f;
+        float mass1 = ball1.radius * ball1.radius;
+        float mass2 = ball2.radius * ball2.radius;
+        float totalMass = mass1 + mass2;
+        float j = -(1.0f + restitution) * relativeVelocity * (mass1 * mass2 / totalMass);
+        float overlap = max(minDist - distance, 0.0f) * 0.8f;
+        float dv1x = -j * nx / mass1;
+        float dv1y = -j * ny / mass1;
+        float dv2x = j * nx / mass2;
+        float dv2y = j * ny / mass2;
+
+        volatile __global float* delta1 = ballDeltas + 4 * contact.a;
+        volatile __global float* delta2 = ballDeltas + 4 * contact.b;
+        atomicAddFloat(&delta1[0], dv1x);
+        atomicAddFloat(&delta1[1], dv1y);
+        atomicAddFloat(&delta1[2], dv1x * rewind - nx * overlap * mass2 / totalMass);
+        atomicAddFloat(&delta1[3], dv1y * rewind - ny * overlap * mass2 / totalMass);
+        atomicAddFloat(&delta2[0], dv2x);
+        atomicAddFloat(&delta2[1], dv2y);
+        atomicAddFloat(&delta2[2], dv2x * rewind + nx * overlap * mass1 / totalMass);
+        atomicAddFloat(&delta2[3], dv2y * rewind + ny * overlap * mass1 / totalMass);
+        atomic_inc(&ballContactCounts[contact.a]);
+        atomic_inc(&ballContactCounts[contact.b]);
+        collisions++;
+    }
+    if (collisions > 0) {
+        atomic_add(collisionCount, collisions);
+    }
+}
+
+// Applies the relaxed deltas to every candidate ball and clears them for
+// the next iteration; collision friction compounds per applied impulse
+__kernel void applyContactDeltas(
+    __global Ball* balls,              // Array of all balls in simulation
+    __global const int* contactList,   // Indices of balls with candidate contacts
+    __global const int* activeCounts,  // Active list sizes
+    __global float4* ballDeltas,       // Accumulated per-ball corrections
+    __global int* ballContactCounts,   // Impulses applied per ball
+    const float relaxation             // Scale on accumulated corrections
+) {
+    int count = activeCounts[ACTIVE_CONTACT];
+
+    for (int k = get_global_id(0); k < count; k += get_global_size(0)) {
+        int i = contactList[k];
+        int impulses = ballContactCounts[i];
+        if (impulses == 0) continue;
+
+        float4 delta = ballDeltas[i];
+        Ball ball = balls[i];
+        float friction = pown(0.98f, impulses);
+        ball.velocity.x = (ball.velocity.x + relaxation * delta.x) * friction;
+        ball.velocity.y = (ball.velocity.y + relaxation * delta.y) * friction;
+        ball.position.x += relaxation * delta.z;
+        ball.position.y += relaxation * delta.w;
+        balls[i] = ball;
+
+        ballDeltas[i] = (float4)(0.0f);
+        ballContactCounts[i] = 0;
+    }
+}
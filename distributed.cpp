@@ -0,0 +1,397 @@
+#include "distributed.h"
+#include "simulation.h"
+#include "sim_config.h"
+#include "load_balance.h"
+#include <iostream>
+
+#ifdef BALLSIM_MPI
+
+#include <mpi.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// A ball with its index in the world, so slabs can be gathered in order
+struct TaggedBall {
+    Ball ball;
+    int id;
+    int padding[3];
+};
+
+// Message tags of the per-step exchange
+const int TAG_HEADER = 1;   // Migrant and ghost counts
+const int TAG_BALLS = 2;    // Migrants followed by ghosts
+
+// Neighbour sides
+const int LEFT = 0;
+const int RIGHT = 1;
+
+int rank = 0;
+int size = 1;
+MPI_Datatype ballType;
+int neighbours[2];          // Rank on each side, or MPI_PROC_NULL at a world wall
+
+std::vector<float> edges;   // Rank r owns [edges[r], edges[r + 1])
+float slabLow, slabHigh;    // This rank's slab
+float ghostWidth;
+std::vector<TaggedBall> owned;
+
+double stepTime = 0.0;      // Seconds of local work since the last rebalance
+int framesSinceBalance = 0;
+
+// Interior and border passes run on separate pipelines of the main device,
+// so the interior's buffers stay untouched while the border pass is set up
+SimulationPipeline* interiorPipeline = nullptr;
+SimulationPipeline* borderPipeline = nullptr;
+std::vector<Ball> interiorBalls, borderBalls;
+cl_event interiorReadEvent;
+
+std::vector<TaggedBall> gathered;
+std::vector<Ball> world;
+
+// Rank whose slab holds x; balls outside the world belong to the edge slabs
+int ownerOf(float x) {
+    int r = static_cast<int>(std::upper_bound(edges.begin(), edges.end(), x) - edges.begin()) - 1;
+    return std::clamp(r, 0, size - 1);
+}
+
+bool nearLeft(float x, float width) {
+    return neighbours[LEFT] != MPI_PROC_NULL && x < slabLow + width;
+}
+
+bool nearRight(float x, float width) {
+    return neighbours[RIGHT] != MPI_PROC_NULL && x >= slabHigh - width;
+}
+
+// Uploads balls to a pipeline and enqueues one step over them
+void enqueueStep(SimulationPipeline* pipeline, const std::vector<Ball>& balls, float deltaTime) {
+    int count = static_cast<int>(balls.size());
+    reservePipelineBalls(pipeline, count);
+    cl_int error = clEnqueueWriteBuffer(queue, pipelineBallBuffer(pipeline), CL_FALSE, 0, sizeof(Ball) * count,
+                                        balls.data(), 0, nullptr, nullptr);
+    checkError(error, "writing slab balls");
+    simulatePipelineFrame(pipeline, count, deltaTime);
+}
+
+// Rank 0 sorts the world by slab and scatters it, replacing every rank's
+// owned balls
+void scatterWorld(const std::vector<Ball>& balls) {
+    std::vector<int> counts(size), offsets(size);
+    std::vector<TaggedBall> sorted;
+    if (rank == 0) {
+        std::vector<std::vector<TaggedBall>> slabs(size);
+        for (int i = 0; i < static_cast<int>(balls.size()); i++) {
+            slabs[ownerOf(balls[i].position.x)].push_back(TaggedBall{balls[i], i, {}});
+        }
+        for (int r = 0; r < size; r++) {
+            counts[r] = static_cast<int>(slabs[r].size());
+            offsets[r] = static_cast<int>(sorted.size());
+            sorted.insert(sorted.end(), slabs[r].begin(), slabs[r].end());
+        }
+    }
+    int count = 0;
+    MPI_Scatter(counts.data(), 1, MPI_INT, &count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    owned.resize(count);
+    MPI_Scatterv(sorted.data(), counts.data(), offsets.data(), ballType,
+                 owned.data(), count, ballType, 0, MPI_COMM_WORLD);
+}
+
+// Gathers every slab to rank 0 and puts the balls back in world order
+void gatherWorld() {
+    int count = static_cast<int>(owned.size());
+    std::vector<int> counts(size), offsets(size);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 1; r < size; r++) {
+            offsets[r] = offsets[r - 1] + counts[r - 1];
+        }
+        gathered.resize(offsets[size - 1] + counts[size - 1]);
+    }
+    MPI_Gatherv(owned.data(), count, ballType, gathered.data(), counts.data(), offsets.data(), ballType,
+                0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        world.resize(gathered.size());
+        for (const TaggedBall& tagged : gathered) {
+            world[tagged.id] = tagged.ball;
+        }
+    }
+}
+
+// Moves the slab edges so every rank gets an equal share of the measured
+// work, then redistributes the world over the new slabs
+// Slabs stay at least one ghost width wide
+void rebalanceSlabs() {
+    std::vector<double> stepTimes(size);
+    MPI_Gather(&stepTime, 1, MPI_DOUBLE, stepTimes.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    stepTime = 0.0;
+
+    gatherWorld();
+    if (rank == 0) {
+        edges = balanceStripEdges(world, edges, stepTimes, ghostWidth);
+        reportStripEdges("slabs", edges, stepTimes);
+    }
+    MPI_Bcast(edges.data(), size + 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    slabLow = edges[rank];
+    slabHigh = edges[rank + 1];
+    scatterWorld(world);
+}
+
+}  // namespace
+
+void initDistributed(int* argc, char*** argv) {
+    MPI_Init(argc, argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Type_contiguous(sizeof(TaggedBall), MPI_BYTE, &ballType);
+    MPI_Type_commit(&ballType);
+    neighbours[LEFT] = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    neighbours[RIGHT] = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
+}
+
+int distributedRank() {
+    return rank;
+}
+
+int distributedSize() {
+    return size;
+}
+
+void shareDistributedConfig() {
+    float worldSize[2] = {config.worldWidth, config.worldHeight};
+    MPI_Bcast(&config.numBalls, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(worldSize, 2, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    config.worldWidth = worldSize[0];
+    config.worldHeight = worldSize[1];
+
+    // Border balls need neighbours up to two contact reaches away, and both
+    // balls of a contact may move towards each other during the step
+    float contactReach = 2.0f * MAX_RADIUS + 2.0f * MAX_SPEED * config.maxTimeStep;
+    if (config.continuousCollisions) {
+        contactReach += 2.0f * MAX_SPEED * config.maxTimeStep;
+    }
+    ghostWidth = 2.0f * contactReach;
+
+    // Ghosts and migrants must come from the adjacent slab only
+    if (config.worldWidth / size < ghostWidth) {
+        if (rank == 0) {
+            std::cerr << "Slabs of " << config.worldWidth / size << " units are narrower than the ghost width "
+                      << ghostWidth << "; use a wider --world or fewer ranks" << std::endl;
+        }
+        MPI_Finalize();
+        exit(1);
+    }
+    // Equal-width slabs until the first rebalance
+    edges.resize(size + 1);
+    for (int r = 0; r <= size; r++) {
+        edges[r] = config.worldWidth * r / size;
+    }
+    slabLow = edges[rank];
+    slabHigh = edges[rank + 1];
+}
+
+void initDistributedSimulation(const std::vector<Ball>& balls) {
+    scatterWorld(balls);
+
+    int count = static_cast<int>(owned.size());
+    int capacity = std::max(1, count + count / 2);
+    interiorPipeline = createPipeline(context, device, queue, capacity);
+    borderPipeline = createPipeline(context, device, queue, capacity);
+    std::cout << "Rank " << rank << " owns x in [" << slabLow << ", " << slabHigh << ") with "
+              << count << " balls" << std::endl;
+}
+
+bool syncDistributedFrame(float& deltaTime, bool running) {
+    float values[2] = {deltaTime, running ? 1.0f : 0.0f};
+    MPI_Bcast(values, 2, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    deltaTime = values[0];
+    return values[1] != 0.0f;
+}
+
+void advanceDistributedSimulation(float deltaTime) {
+    // Time spent waiting on neighbours is left out of the measured work
+    auto start = std::chrono::steady_clock::now();
+    double waiting = 0.0;
+
+    // Balls that left the slab migrate; the rest stay, and those near an edge
+    // are also sent as ghosts
+    std::vector<TaggedBall> kept;
+    std::vector<TaggedBall> outgoing[2];
+    int sendHeader[2][2] = {{0, 0}, {0, 0}};  // Migrants, ghosts per side
+    for (const TaggedBall& tagged : owned) {
+        float x = tagged.ball.position.x;
+        if (neighbours[LEFT] != MPI_PROC_NULL && x < slabLow) {
+            outgoing[LEFT].push_back(tagged);
+        } else if (neighbours[RIGHT] != MPI_PROC_NULL && x >= slabHigh) {
+            outgoing[RIGHT].push_back(tagged);
+        } else {
+            kept.push_back(tagged);
+        }
+    }
+    for (int side : {LEFT, RIGHT}) {
+        sendHeader[side][0] = static_cast<int>(outgoing[side].size());
+    }
+    for (const TaggedBall& tagged : kept) {
+        float x = tagged.ball.position.x;
+        if (nearLeft(x, ghostWidth)) outgoing[LEFT].push_back(tagged);
+        if (nearRight(x, ghostWidth)) outgoing[RIGHT].push_back(tagged);
+    }
+
+    // Post the exchange; sends to MPI_PROC_NULL complete at once
+    int receiveHeader[2][2] = {{0, 0}, {0, 0}};
+    MPI_Request headerRequests[4], sendRequests[2];
+    for (int side : {LEFT, RIGHT}) {
+        sendHeader[side][1] = static_cast<int>(outgoing[side].size()) - sendHeader[side][0];
+        MPI_Irecv(receiveHeader[side], 2, MPI_INT, neighbours[side], TAG_HEADER, MPI_COMM_WORLD,
+                  &headerRequests[side]);
+        MPI_Isend(sendHeader[side], 2, MPI_INT, neighbours[side], TAG_HEADER, MPI_COMM_WORLD,
+                  &headerRequests[2 + side]);
+        MPI_Isend(outgoing[side].data(), static_cast<int>(outgoing[side].size()), ballType, neighbours[side],
+                  TAG_BALLS, MPI_COMM_WORLD, &sendRequests[side]);
+    }
+
+    // Interior pass over every kept ball while the messages are in flight
+    // Only balls beyond the ghost width from both edges keep its result;
+    // their neighbours, and their neighbours' neighbours, are all local
+    interiorBalls.resize(kept.size());
+    for (size_t k = 0; k < kept.size(); k++) {
+        interiorBalls[k] = kept[k].ball;
+    }
+    if (!kept.empty()) {
+        enqueueStep(interiorPipeline, interiorBalls, deltaTime);
+        cl_int error = clEnqueueReadBuffer(queue, pipelineBallBuffer(interiorPipeline), CL_FALSE, 0,
+                                           sizeof(Ball) * kept.size(), interiorBalls.data(),
+                                           0, nullptr, &interiorReadEvent);
+        checkError(error, "reading slab interior");
+        clFlush(queue);
+    }
+
+    // Receive migrants and ghosts from both neighbours
+    auto waitStart = std::chrono::steady_clock::now();
+    MPI_Waitall(4, headerRequests, MPI_STATUSES_IGNORE);
+    std::vector<TaggedBall> incoming[2];
+    MPI_Request receiveRequests[2];
+    for (int side : {LEFT, RIGHT}) {
+        incoming[side].resize(receiveHeader[side][0] + receiveHeader[side][1]);
+        MPI_Irecv(incoming[side].data(), static_cast<int>(incoming[side].size()), ballType, neighbours[side],
+                  TAG_BALLS, MPI_COMM_WORLD, &receiveRequests[side]);
+    }
+    MPI_Waitall(2, receiveRequests, MPI_STATUSES_IGNORE);
+    waiting += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+
+    // Border pass: kept balls near an edge and arrived migrants keep its
+    // result; the next band inwards, arrived ghosts and the migrants that
+    // just left (which now sit across the edge) are context only
+    std::vector<int> borderIndex;      // Into kept, or kept.size() + k for arrived migrant k
+    std::vector<TaggedBall> arrived;
+    std::vector<Ball> surroundings;
+    for (int side : {LEFT, RIGHT}) {
+        int migrants = receiveHeader[side][0];
+        arrived.insert(arrived.end(), incoming[side].begin(), incoming[side].begin() + migrants);
+        for (size_t k = migrants; k < incoming[side].size(); k++) {
+            surroundings.push_back(incoming[side][k].ball);
+        }
+        for (int k = 0; k < sendHeader[side][0]; k++) {
+            surroundings.push_back(outgoing[side][k].ball);
+        }
+    }
+    borderBalls.clear();
+    for (size_t k = 0; k < kept.size(); k++) {
+        float x = kept[k].ball.position.x;
+        if (nearLeft(x, ghostWidth) || nearRight(x, ghostWidth)) {
+            borderIndex.push_back(static_cast<int>(k));
+            borderBalls.push_back(kept[k].ball);
+        } else if (nearLeft(x, 2.0f * ghostWidth) || nearRight(x, 2.0f * ghostWidth)) {
+            surroundings.push_back(kept[k].ball);
+        }
+    }
+    for (size_t k = 0; k < arrived.size(); k++) {
+        borderIndex.push_back(static_cast<int>(kept.size() + k));
+        borderBalls.push_back(arrived[k].ball);
+    }
+    size_t borderCount = borderBalls.size();
+    borderBalls.insert(borderBalls.end(), surroundings.begin(), surroundings.end());
+
+    if (borderCount > 0) {
+        enqueueStep(borderPipeline, borderBalls, deltaTime);
+        cl_int error = clEnqueueReadBuffer(queue, pipelineBallBuffer(borderPipeline), CL_TRUE, 0,
+                                           sizeof(Ball) * borderCount, borderBalls.data(), 0, nullptr, nullptr);
+        checkError(error, "reading slab border");
+    }
+    if (!kept.empty()) {
+        clWaitForEvents(1, &interiorReadEvent);
+        clReleaseEvent(interiorReadEvent);
+    }
+
+    // Interior results first, then border results over them
+    owned = kept;
+    owned.insert(owned.end(), arrived.begin(), arrived.end());
+    for (size_t k = 0; k < kept.size(); k++) {
+        owned[k].ball = interiorBalls[k];
+    }
+    for (size_t k = 0; k < borderCount; k++) {
+        owned[borderIndex[k]].ball = borderBalls[k];
+    }
+    waitStart = std::chrono::steady_clock::now();
+    MPI_Waitall(2, sendRequests, MPI_STATUSES_IGNORE);
+    auto end = std::chrono::steady_clock::now();
+    waiting += std::chrono::duration<double>(end - waitStart).count();
+    stepTime += std::chrono::duration<double>(end - start).count() - waiting;
+
+    if (++framesSinceBalance >= config.rebalanceInterval) {
+        rebalanceSlabs();
+        framesSinceBalance = 0;
+    }
+}
+
+const std::vector<Ball>& gatherDistributedWorld() {
+    gatherWorld();
+    return world;
+}
+
+void finalizeDistributed() {
+    if (interiorPipeline) {
+        clFinish(queue);
+        releasePipeline(interiorPipeline);
+        releasePipeline(borderPipeline);
+    }
+    MPI_Type_free(&ballType);
+    MPI_Finalize();
+}
+
+#else
+
+// Single-process build: always rank 0 of 1, so the distributed paths never run
+
+void initDistributed(int*, char***) {}
+
+int distributedRank() {
+    return 0;
+}
+
+int distributedSize() {
+    return 1;
+}
+
+void shareDistributedConfig() {}
+
+void initDistributedSimulation(const std::vector<Ball>&) {
+    std::cerr << "Distributed mode needs a build with BALLSIM_MPI" << std::endl;
+    exit(1);
+}
+
+bool syncDistributedFrame(float&, bool running) {
+    return running;
+}
+
+void advanceDistributedSimulation(float) {}
+
+const std::vector<Ball>& gatherDistributedWorld() {
+    static const std::vector<Ball> empty;
+    return empty;
+}
+
+void finalizeDistributed() {}
+
+#endif // BALLSIM_MPI
@@ -0,0 +1,46 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <vector>
+#include "ball_def.h"
+
+// MPI distributed simulation: the world is cut into vertical slabs, one per
+// rank, and every rank runs the simulation kernels on its own slab
+// Each step, a rank sends its neighbours the balls that left its slab
+// (migration) and the balls within the ghost width of the shared edge
+// (ghosts) with non-blocking sends. While they are in flight, the device
+// steps the slab interior, which needs no remote balls. The border band is
+// stepped once the ghosts have arrived. Every config.rebalanceInterval frames
+// the slab edges move to even out the ranks' measured work (load_balance.h)
+// Builds without BALLSIM_MPI run as rank 0 of a single process
+
+// Starts MPI; call before anything else reads argv
+void initDistributed(int* argc, char*** argv);
+
+int distributedRank();
+int distributedSize();
+
+// Copies rank 0's ball count and world size, which a restore or --packing
+// may have changed, to every rank; exits if slabs are narrower than the
+// ghost width
+void shareDistributedConfig();
+
+// Scatters rank 0's initial world so every rank keeps the balls of its slab
+// Other ranks pass an empty vector
+void initDistributedSimulation(const std::vector<Ball>& balls);
+
+// Broadcasts rank 0's time step and whether it keeps running; returns the flag
+bool syncDistributedFrame(float& deltaTime, bool running);
+
+// Steps the local slab, exchanging ghosts and migrating balls with the
+// neighbouring ranks
+void advanceDistributedSimulation(float deltaTime);
+
+// Gathers every slab to rank 0 in the original ball order
+// Returns an empty vector on other ranks
+const std::vector<Ball>& gatherDistributedWorld();
+
+// Releases the slab pipelines and shuts MPI down
+void finalizeDistributed();
+
+#endif // DISTRIBUTED_H
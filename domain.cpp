@@ -0,0 +1,241 @@
+#include "domain.h"
+#include "simulation.h"
+#include "sim_config.h"
+#include "load_balance.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// One strip of the world and the device that simulates it
+struct Partition {
+    cl_device_id device;
+    cl_context context;
+    cl_command_queue queue;
+    SimulationPipeline* pipeline;
+    std::vector<int> ids;      // World index of each ball in balls
+    std::vector<Ball> balls;   // Owned balls first, then halo copies
+    int ownedCount;
+    double stepTime;           // Seconds spent stepping since the last rebalance
+};
+
+std::vector<Partition> partitions;
+std::vector<float> edges;      // Strip p covers [edges[p], edges[p + 1])
+std::vector<Ball> world;
+float haloWidth;
+int framesSinceBalance = 0;
+bool subDevices = false;       // Strips run on sub-devices of the main device
+
+// Strip holding x; balls outside the world belong to the edge strips
+int stripOf(float x) {
+    int strip = static_cast<int>(std::upper_bound(edges.begin(), edges.end(), x) - edges.begin()) - 1;
+    return std::clamp(strip, 0, static_cast<int>(partitions.size()) - 1);
+}
+
+// Assigns every ball to the strip holding its centre and copies the balls
+// within haloWidth of another strip into that strip's halo
+void distributeBalls() {
+    std::vector<std::vector<int>> halos(partitions.size());
+    for (Partition& partition : partitions) {
+        partition.ids.clear();
+    }
+
+    int last = static_cast<int>(partitions.size()) - 1;
+    for (int i = 0; i < static_cast<int>(world.size()); i++) {
+        float x = world[i].position.x;
+        int owner = stripOf(x);
+        partitions[owner].ids.push_back(i);
+
+        // Halos may span several strips when strips are narrower than the halo
+        for (int q = owner - 1; q >= 0 && x < edges[q + 1] + haloWidth; q--) {
+            halos[q].push_back(i);
+        }
+        for (int q = owner + 1; q <= last && x >= edges[q] - haloWidth; q++) {
+            halos[q].push_back(i);
+        }
+    }
+
+    for (size_t p = 0; p < partitions.size(); p++) {
+        Partition& partition = partitions[p];
+        partition.ownedCount = static_cast<int>(partition.ids.size());
+        partition.ids.insert(partition.ids.end(), halos[p].begin(), halos[p].end());
+        partition.balls.resize(partition.ids.size());
+        for (size_t k = 0; k < partition.ids.size(); k++) {
+            partition.balls[k] = world[partition.ids[k]];
+        }
+    }
+}
+
+// Uploads a strip, steps it and gathers its owned balls back into the world
+// Strips write disjoint world entries, so they run on their own threads
+void stepPartition(Partition& partition, float deltaTime) {
+    TraceSpan span("step strip");
+    auto start = std::chrono::steady_clock::now();
+    int count = static_cast<int>(partition.balls.size());
+    if (count > 0) {
+        reservePipelineBalls(partition.pipeline, count);
+        cl_mem balls = pipelineBallBuffer(partition.pipeline);
+        cl_int error = clEnqueueWriteBuffer(partition.queue, balls, CL_FALSE, 0, sizeof(Ball) * count,
+                                           partition.balls.data(), 0, nullptr, nullptr);
+        checkError(error, "writing strip balls");
+        simulatePipelineFrame(partition.pipeline, count, deltaTime);
+
+        // Halo copies are recomputed by their owners, so only owned balls come back
+        if (partition.ownedCount > 0) {
+            error = clEnqueueReadBuffer(partition.queue, balls, CL_TRUE, 0, sizeof(Ball) * partition.ownedCount,
+                                        partition.balls.data(), 0, nullptr, nullptr);
+            checkError(error, "reading strip balls");
+        }
+    }
+    for (int k = 0; k < partition.ownedCount; k++) {
+        world[partition.ids[k]] = partition.balls[k];
+    }
+    partition.stepTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Moves the strip edges so every strip gets an equal share of the measured cost
+void rebalanceStrips() {
+    std::vector<double> stepTimes;
+    for (Partition& partition : partitions) {
+        stepTimes.push_back(partition.stepTime);
+        partition.stepTime = 0.0;
+    }
+    edges = balanceStripEdges(world, edges, stepTimes, 2.0f * MAX_RADIUS);
+    reportStripEdges("strips", edges, stepTimes);
+}
+
+// Every device of every platform, in platform order
+std::vector<cl_device_id> listAllDevices() {
+    cl_uint numPlatforms = 0;
+    clGetPlatformIDs(0, nullptr, &numPlatforms);
+    std::vector<cl_platform_id> platforms(numPlatforms);
+    clGetPlatformIDs(numPlatforms, platforms.data(), nullptr);
+
+    std::vector<cl_device_id> devices;
+    for (cl_platform_id platformId : platforms) {
+        cl_uint numDevices = 0;
+        if (clGetDeviceIDs(platformId, CL_DEVICE_TYPE_ALL, 0, nullptr, &numDevices) != CL_SUCCESS) continue;
+        std::vector<cl_device_id> platformDevices(numDevices);
+        clGetDeviceIDs(platformId, CL_DEVICE_TYPE_ALL, numDevices, platformDevices.data(), nullptr);
+        devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
+    }
+    if (static_cast<int>(devices.size()) < config.devices) {
+        std::cerr << "--devices=" << config.devices << " requested but only " << devices.size()
+                  << " OpenCL devices are available" << std::endl;
+        exit(1);
+    }
+    return devices;
+}
+
+// Splits the main device into config.devices sub-devices over disjoint
+// compute units, spreading any remainder over the first ones
+std::vector<cl_device_id> splitMainDevice() {
+    cl_uint computeUnits = 0, maxSubDevices = 0;
+    cl_int error = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(computeUnits),
+                                   &computeUnits, nullptr);
+    error |= clGetDeviceInfo(device, CL_DEVICE_PARTITION_MAX_SUB_DEVICES, sizeof(maxSubDevices),
+                             &maxSubDevices, nullptr);
+    checkError(error, "getting device partition limits");
+    cl_uint parts = static_cast<cl_uint>(config.devices);
+    if (maxSubDevices < parts || computeUnits < parts) {
+        std::cerr << "--fission cannot split the device into " << parts << " parts (" << computeUnits
+                  << " compute units, at most " << maxSubDevices << " sub-devices)" << std::endl;
+        exit(1);
+    }
+
+    std::vector<cl_device_partition_property> properties = {CL_DEVICE_PARTITION_BY_COUNTS};
+    for (cl_uint p = 0; p < parts; p++) {
+        properties.push_back(computeUnits / parts + (p < computeUnits % parts ? 1 : 0));
+    }
+    properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+    properties.push_back(0);
+
+    std::vector<cl_device_id> devices(parts);
+    error = clCreateSubDevices(device, properties.data(), parts, devices.data(), nullptr);
+    checkError(error, "creating sub-devices");
+    return devices;
+}
+
+}  // namespace
+
+void initDomainDecomposition(const std::vector<Ball>& balls) {
+    subDevices = config.deviceFission;
+    std::vector<cl_device_id> devices = subDevices ? splitMainDevice() : listAllDevices();
+
+    // A separate context per device, since devices may come from different platforms
+    partitions.resize(config.devices);
+    for (int p = 0; p < config.devices; p++) {
+        Partition& partition = partitions[p];
+        cl_int error;
+        partition.device = devices[p];
+        partition.context = clCreateContext(nullptr, 1, &partition.device, nullptr, nullptr, &error);
+        checkError(error, "creating strip context");
+        partition.queue = clCreateCommandQueue(partition.context, partition.device, 0, &error);
+        checkError(error, "creating strip command queue");
+
+        int expectedBalls = static_cast<int>(balls.size()) / config.devices + 1;
+        partition.pipeline = createPipeline(partition.context, partition.device, partition.queue, expectedBalls);
+        partition.stepTime = 0.0;
+
+        char deviceName[128];
+        clGetDeviceInfo(partition.device, CL_DEVICE_NAME, sizeof(deviceName), deviceName, nullptr);
+        cl_uint computeUnits = 0;
+        clGetDeviceInfo(partition.device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(computeUnits),
+                        &computeUnits, nullptr);
+        std::cout << "Strip " << p << ": " << deviceName << " (" << computeUnits << " compute units)" << std::endl;
+    }
+
+    // Equal-width strips until the first rebalance
+    edges.resize(config.devices + 1);
+    for (int p = 0; p <= config.devices; p++) {
+        edges[p] = config.worldWidth * p / config.devices;
+    }
+
+    // A ball can touch another up to a contact distance away, and both may
+    // move towards each other during the step; twice that keeps the halo
+    // balls' own nearest neighbours in the strip too
+    float contactReach = 2.0f * MAX_RADIUS + 2.0f * MAX_SPEED * config.maxTimeStep;
+    if (config.continuousCollisions) {
+        contactReach += 2.0f * MAX_SPEED * config.maxTimeStep;
+    }
+    haloWidth = 2.0f * contactReach;
+
+    world = balls;
+    distributeBalls();
+}
+
+const std::vector<Ball>& advanceDomainSimulation(float deltaTime) {
+    std::vector<std::thread> threads;
+    for (size_t p = 1; p < partitions.size(); p++) {
+        threads.emplace_back(stepPartition, std::ref(partitions[p]), deltaTime);
+    }
+    stepPartition(partitions[0], deltaTime);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // Migrate balls that crossed a strip edge, or whose strip moved, and
+    // refresh the halos
+    if (++framesSinceBalance >= config.rebalanceInterval) {
+        rebalanceStrips();
+        framesSinceBalance = 0;
+    }
+    distributeBalls();
+    return world;
+}
+
+void cleanupDomainDecomposition() {
+    for (Partition& partition : partitions) {
+        clFinish(partition.queue);
+        releasePipeline(partition.pipeline);
+        clReleaseCommandQueue(partition.queue);
+        clReleaseContext(partition.context);
+        if (subDevices) {
+            clReleaseDevice(partition.device);
+        }
+    }
+    partitions.clear();
+}
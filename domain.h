@@ -0,0 +1,28 @@
+#ifndef DOMAIN_H
+#define DOMAIN_H
+
+#include <vector>
+#include "ball_def.h"
+
+// Spatial domain decomposition across several OpenCL devices in one process
+// The world is cut into vertical strips, one per device. Each device runs the
+// full simulation pipeline on the balls it owns plus a halo of copies of the
+// balls just across its strip edges. After every step the host gathers the
+// owned balls and redistributes them, which migrates balls that crossed a
+// strip edge and refreshes every halo
+// Every config.rebalanceInterval frames the strip edges move to even out the
+// measured step times (load_balance.h)
+
+// Opens config.devices devices across all platforms, or with --fission as many
+// sub-devices of the main device over disjoint compute units, and distributes
+// the initial balls; exits if fewer devices are available
+void initDomainDecomposition(const std::vector<Ball>& balls);
+
+// Steps every strip concurrently and returns the gathered world, in the
+// original ball order
+const std::vector<Ball>& advanceDomainSimulation(float deltaTime);
+
+// Releases the devices of the decomposition
+void cleanupDomainDecomposition();
+
+#endif // DOMAIN_H
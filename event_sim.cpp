@@ -0,0 +1,469 @@
+#include "event_sim.h"
+#include "simulation.h"
+#include "sim_config.h"
+#include <queue>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+const double NEVER = std::numeric_limits<double>::infinity();
+
+// Event budget per ball per frame before falling back to a plain drift,
+// guarding against inelastic collapse (infinitely many shrinking bounces)
+const int MAX_EVENTS_PER_BALL = 64;
+
+// Samples used to bracket pair contacts when the balls accelerate differently
+const int CONTACT_SAMPLES = 32;
+
+// Ball state, valid at its own local time
+struct EventBall {
+    double time;
+    double x, y, vx, vy;
+    double radius;
+    int cell;
+    bool resting;           // On the floor with gravity cancelled
+    unsigned int version;   // Bumped on every state change; stale events are skipped
+};
+
+enum EventType { PAIR_EVENT, WALL_EVENT, CELL_EVENT };
+enum Wall { LEFT_WALL, RIGHT_WALL, CEILING, FLOOR };
+
+struct Event {
+    double time;
+    EventType type;
+    int a;                  // Ball
+    int b;                  // Other ball, wall or new cell
+    unsigned int versionA, versionB;
+};
+
+struct LaterEvent {
+    bool operator()(const Event& lhs, const Event& rhs) const { return lhs.time > rhs.time; }
+};
+
+std::vector<EventBall> eventBalls;
+std::vector<std::vector<int>> cellBalls;  // Ball indices per broad-phase cell
+std::priority_queue<Event, std::vector<Event>, LaterEvent> events;
+std::vector<Ball> snapshot;
+double currentTime = 0.0;
+long long eventCount = 0;
+bool budgetWarned = false;
+int eventGridWidth, eventGridHeight;
+
+// Vertical acceleration of a ball (y grows downwards)
+double accelerationOf(const EventBall& ball) {
+    return ball.resting ? 0.0 : GRAVITY;
+}
+
+// Moves a ball along its ballistic path to time t
+void advanceBall(EventBall& ball, double t) {
+    double dt = t - ball.time;
+    double g = accelerationOf(ball);
+    ball.x += ball.vx * dt;
+    ball.y += ball.vy * dt + 0.5 * g * dt * dt;
+    ball.vy += g * dt;
+    ball.time = t;
+}
+
+// Smallest root >= 0 of 0.5*a*t^2 + b*t + c = 0, or NEVER
+double firstRoot(double a, double b, double c) {
+    if (a == 0.0) {
+        if (b == 0.0) return NEVER;
+        double t = -c / b;
+        return t >= 0.0 ? t : NEVER;
+    }
+    double disc = b * b - 2.0 * a * c;
+    if (disc < 0.0) return NEVER;
+
+    // Cancellation-free roots, so a ball sitting on a limit and moving away
+    // does not see a spurious root at zero
+    double q = -0.5 * (b + std::copysign(std::sqrt(disc), b));
+    if (q == 0.0) return 0.0;
+    double t1 = 2.0 * q / a;
+    double t2 = c / q;
+    if (t1 > t2) std::swap(t1, t2);
+    if (t1 >= 0.0) return t1;
+    if (t2 >= 0.0) return t2;
+    return NEVER;
+}
+
+// Return time to a limit the coordinate is leaving, or NEVER
+double returnTime(double v, double a) {
+    if (a == 0.0) return NEVER;
+    double t = -2.0 * v / a;
+    return t > 0.0 ? t : NEVER;
+}
+
+// Time until a coordinate with velocity v and acceleration a first reaches
+// an upper limit from below (c = position - limit, clamped so a ball
+// already past the limit by rounding crosses immediately)
+double timeToReachUpper(double position, double limit, double v, double a) {
+    double c = std::min(position - limit, 0.0);
+    if (c == 0.0) return (v > 0.0 || (v == 0.0 && a > 0.0)) ? 0.0 : returnTime(v, a);
+    return firstRoot(a, v, c);
+}
+
+// Time until a coordinate first reaches a lower limit from above
+double timeToReachLower(double position, double limit, double v, double a) {
+    double c = std::max(position - limit, 0.0);
+    if (c == 0.0) return (v < 0.0 || (v == 0.0 && a < 0.0)) ? 0.0 : returnTime(v, a);
+    return firstRoot(a, v, c);
+}
+
+int cellOf(double x, double y) {
+    int cx = std::clamp(static_cast<int>(x / CELL_SIZE), 0, eventGridWidth - 1);
+    int cy = std::clamp(static_cast<int>(y / CELL_SIZE), 0, eventGridHeight - 1);
+    return cy * eventGridWidth + cx;
+}
+
+// Earliest wall or cell-crossing event of a ball, relative to its local time
+// Fills the event if requested
+double nextSelfEvent(const EventBall& ball, Event* next) {
+    double g = accelerationOf(ball);
+    double best = NEVER;
+    EventType type = WALL_EVENT;
+    int target = 0;
+
+    auto consider = [&](double t, EventType eventType, int eventTarget) {
+        if (t < best) {
+            best = t;
+            type = eventType;
+            target = eventTarget;
+        }
+    };
+
+    // Walls
+    consider(timeToReachLower(ball.x, ball.radius, ball.vx, 0.0), WALL_EVENT, LEFT_WALL);
+    consider(timeToReachUpper(ball.x, config.worldWidth - ball.radius, ball.vx, 0.0), WALL_EVENT, RIGHT_WALL);
+    if (!ball.resting) {
+        consider(timeToReachLower(ball.y, ball.radius, ball.vy, g), WALL_EVENT, CEILING);
+        consider(timeToReachUpper(ball.y, config.worldHeight - ball.radius, ball.vy, g), WALL_EVENT, FLOOR);
+    }
+
+    // Cell crossings, never out of the grid
+    int cx = ball.cell % eventGridWidth;
+    int cy = ball.cell / eventGridWidth;
+    if (cx > 0) {
+        consider(timeToReachLower(ball.x, cx * CELL_SIZE, ball.vx, 0.0), CELL_EVENT, ball.cell - 1);
+    }
+    if (cx < eventGridWidth - 1) {
+        consider(timeToReachUpper(ball.x, (cx + 1) * CELL_SIZE, ball.vx, 0.0), CELL_EVENT, ball.cell + 1);
+    }
+    if (cy > 0) {
+        consider(timeToReachLower(ball.y, cy * CELL_SIZE, ball.vy, g), CELL_EVENT, ball.cell - eventGridWidth);
+    }
+    if (cy < eventGridHeight - 1) {
+        consider(timeToReachUpper(ball.y, (cy + 1) * CELL_SIZE, ball.vy, g), CELL_EVENT,
+                 ball.cell + eventGridWidth);
+    }
+
+    if (next && best < NEVER) {
+        next->time = ball.time + best;
+        next->type = type;
+        next->b = target;
+    }
+    return best;
+}
+
+// Squared gap function |d(t)|^2 - R^2 for relative motion d0 + dv t + 0.5 da t^2
+double pairGap(double dx, double dy, double dvx, double dvy, double day, double minDist, double t) {
+    double x = dx + dvx * t;
+    double y = dy + dvy * t + 0.5 * day * t * t;
+    return x * x + y * y - minDist * minDist;
+}
+
+// Earliest time within the horizon at which two balls touch, or NEVER
+// Relative motion is linear when both balls accelerate alike, else quadratic
+double pairContactTime(const EventBall& a, const EventBall& b, double horizon) {
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double dvx = b.vx - a.vx;
+    double dvy = b.vy - a.vy;
+    double day = accelerationOf(b) - accelerationOf(a);
+    double minDist = a.radius + b.radius;
+    double c = dx * dx + dy * dy - minDist * minDist;
+    double approach = dx * dvx + dy * dvy;
+
+    // Already overlapping: collide now if approaching
+    if (c < 0.0) return approach < 0.0 ? 0.0 : NEVER;
+
+    if (day == 0.0) {
+        double qa = dvx * dvx + dvy * dvy;
+        double qb = 2.0 * approach;
+        if (qa == 0.0 || qb >= 0.0) return NEVER;
+        double disc = qb * qb - 4.0 * qa * c;
+        if (disc < 0.0) return NEVER;
+        double t = 2.0 * c / (-qb + std::sqrt(disc));
+        return t <= horizon ? std::max(t, 0.0) : NEVER;
+    }
+
+    // Bracket the first sign change, then bisect
+    if (!(horizon < NEVER)) return NEVER;
+    double previous = 0.0;
+    for (int k = 1; k <= CONTACT_SAMPLES; k++) {
+        double t = horizon * k / CONTACT_SAMPLES;
+        if (pairGap(dx, dy, dvx, dvy, day, minDist, t) <= 0.0) {
+            double lo = previous, hi = t;
+            for (int iteration = 0; iteration < 40; iteration++) {
+                double mid = 0.5 * (lo + hi);
+                if (pairGap(dx, dy, dvx, dvy, day, minDist, mid) <= 0.0) hi = mid; else lo = mid;
+            }
+            return lo;
+        }
+        previous = t;
+    }
+    return NEVER;
+}
+
+// Schedules the next self event of a ball and its contacts with neighbours
+void predictBall(int i) {
+    EventBall& ball = eventBalls[i];
+
+    Event self{0.0, WALL_EVENT, i, 0, ball.version, 0};
+    double selfTime = nextSelfEvent(ball, &self);
+    if (selfTime < NEVER) {
+        events.push(self);
+    }
+
+    int cx = ball.cell % eventGridWidth;
+    int cy = ball.cell / eventGridWidth;
+    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, eventGridHeight - 1); y++) {
+        for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, eventGridWidth - 1); x++) {
+            for (int j : cellBalls[y * eventGridWidth + x]) {
+                if (j == i) continue;
+                EventBall other = eventBalls[j];
+                advanceBall(other, currentTime);
+
+                // Either ball re-predicts at its next self event, so
+                // contacts beyond that horizon need not be found now
+                double horizon = std::min(selfTime, nextSelfEvent(other, nullptr));
+                double t = pairContactTime(ball, other, horizon);
+                if (t < NEVER) {
+                    events.push(Event{currentTime + t, PAIR_EVENT, i, j,
+                                      ball.version, eventBalls[j].version});
+                }
+            }
+        }
+    }
+}
+
+// Brings every ball to the current time and schedules all events afresh
+void rebuildEvents() {
+    events = decltype(events)();
+    for (EventBall& ball : eventBalls) {
+        advanceBall(ball, currentTime);
+        ball.version++;
+    }
+    for (int i = 0; i < static_cast<int>(eventBalls.size()); i++) {
+        predictBall(i);
+    }
+}
+
+// Limits speed as the time-stepped integration does
+void clampSpeed(EventBall& ball) {
+    double speed = std::sqrt(ball.vx * ball.vx + ball.vy * ball.vy);
+    if (speed > MAX_SPEED) {
+        ball.vx *= MAX_SPEED / speed;
+        ball.vy *= MAX_SPEED / speed;
+    }
+}
+
+// Keeps a ball inside the walls
+void clampToWorld(EventBall& ball) {
+    ball.x = std::clamp(ball.x, ball.radius, config.worldWidth - ball.radius);
+    ball.y = std::clamp(ball.y, ball.radius, config.worldHeight - ball.radius);
+}
+
+// Puts a ball on the floor once its bounce is too weak to matter
+void settleOnFloor(EventBall& ball) {
+    if (std::fabs(ball.vy) < REST_SPEED) {
+        ball.resting = true;
+        ball.vy = 0.0;
+        ball.y = config.worldHeight - ball.radius;
+    }
+}
+
+void processWall(EventBall& ball, int wall) {
+    const double dampening = 0.7;  // 30% energy loss on collision
+    switch (wall) {
+        case LEFT_WALL:
+            ball.x = ball.radius;
+            ball.vx = std::fabs(ball.vx) * dampening;
+            break;
+        case RIGHT_WALL:
+            ball.x = config.worldWidth - ball.radius;
+            ball.vx = -std::fabs(ball.vx) * dampening;
+            break;
+        case CEILING:
+            ball.y = ball.radius;
+            ball.vy = std::fabs(ball.vy) * dampening;
+            break;
+        case FLOOR:
+            ball.y = config.worldHeight - ball.radius;
+            ball.vy = -std::fabs(ball.vy) * dampening;
+            settleOnFloor(ball);
+            break;
+    }
+}
+
+// Impulse response matching the time-stepped contact solvers
+void processPair(EventBall& ball1, EventBall& ball2) {
+    double dx = ball2.x - ball1.x;
+    double dy = ball2.y - ball1.y;
+    double distance = std::sqrt(dx * dx + dy * dy);
+    if (distance <= 0.0) return;
+
+    double nx = dx / distance;
+    double ny = dy / distance;
+    double relativeVelocity = (ball2.vx - ball1.vx) * nx + (ball2.vy - ball1.vy) * ny;
+    if (relativeVelocity >= 0.0) return;
+
+    // A resting ball pushed into the floor by a flying one is held by it
+    bool onFloor = ball1.resting && ball2.resting;
+    double inverseMass1 = (ball1.resting && !onFloor && ny < 0.0) ? 0.0 : 1.0 / (ball1.radius * ball1.radius);
+    double inverseMass2 = (ball2.resting && !onFloor && ny > 0.0) ? 0.0 : 1.0 / (ball2.radius * ball2.radius);
+
+    // Flying balls separate at REST_SPEED or more, so a ball perched on
+    // others keeps a finite bounce instead of collapsing into ever shorter ones
+    const double restitution = 0.7;
+    double separation = -restitution * relativeVelocity;
+    if (!onFloor) separation = std::max(separation, static_cast<double>(REST_SPEED));
+    double j = (separation - relativeVelocity) / (inverseMass1 + inverseMass2);
+
+    // Separate overlapping balls, which otherwise wedge between neighbours
+    // and collide again at the same instant
+    double overlap = ball1.radius + ball2.radius - distance;
+    if (overlap > 0.0) {
+        double share1 = inverseMass1 / (inverseMass1 + inverseMass2);
+        ball1.x -= nx * overlap * share1;
+        ball1.y -= ny * overlap * share1;
+        ball2.x += nx * overlap * (1.0 - share1);
+        ball2.y += ny * overlap * (1.0 - share1);
+        clampToWorld(ball1);
+        clampToWorld(ball2);
+    }
+
+    ball1.vx = (ball1.vx - j * nx * inverseMass1) * 0.98;
+    ball1.vy = (ball1.vy - j * ny * inverseMass1) * 0.98;
+    ball2.vx = (ball2.vx + j * nx * inverseMass2) * 0.98;
+    ball2.vy = (ball2.vy + j * ny * inverseMass2) * 0.98;
+
+    // Floor contact: resting balls lift off only when pushed upwards
+    for (EventBall* ball : {&ball1, &ball2}) {
+        clampSpeed(*ball);
+        if (ball->resting) {
+            if (ball->vy < -REST_SPEED) {
+                ball->resting = false;
+            } else {
+                // Slow balls on the floor stop, as they sleep when time stepping
+                ball->vy = 0.0;
+                if (std::fabs(ball->vx) < REST_SPEED) ball->vx = 0.0;
+            }
+        }
+    }
+}
+
+void processCellCrossing(int i, int newCell) {
+    EventBall& ball = eventBalls[i];
+    std::vector<int>& oldList = cellBalls[ball.cell];
+    oldList.erase(std::find(oldList.begin(), oldList.end(), i));
+    cellBalls[newCell].push_back(i);
+    ball.cell = newCell;
+}
+
+}  // namespace
+
+void initEventSimulation(const std::vector<Ball>& balls) {
+    eventGridWidth = static_cast<int>(std::ceil(config.worldWidth / CELL_SIZE));
+    eventGridHeight = static_cast<int>(std::ceil(config.worldHeight / CELL_SIZE));
+    cellBalls.assign(eventGridWidth * eventGridHeight, std::vector<int>());
+    currentTime = 0.0;
+    eventCount = 0;
+
+    eventBalls.resize(balls.size());
+    snapshot = balls;
+    for (size_t i = 0; i < balls.size(); i++) {
+        EventBall& ball = eventBalls[i];
+        ball.time = 0.0;
+        ball.x = balls[i].position.x;
+        ball.y = balls[i].position.y;
+        ball.vx = balls[i].velocity.x;
+        ball.vy = balls[i].velocity.y;
+        ball.radius = balls[i].radius;
+        ball.resting = false;
+        ball.version = 0;
+        ball.cell = cellOf(ball.x, ball.y);
+        cellBalls[ball.cell].push_back(static_cast<int>(i));
+    }
+    rebuildEvents();
+}
+
+const std::vector<Ball>& advanceEventSimulation(float deltaTime) {
+    double targetTime = currentTime + deltaTime;
+    long long budget = static_cast<long long>(MAX_EVENTS_PER_BALL) * eventBalls.size() + 1024;
+    long long processed = 0;
+
+    while (!events.empty() && events.top().time <= targetTime) {
+        Event event = events.top();
+        events.pop();
+
+        EventBall& ball = eventBalls[event.a];
+        if (event.versionA != ball.version) continue;
+        if (event.type == PAIR_EVENT && event.versionB != eventBalls[event.b].version) continue;
+
+        currentTime = std::max(currentTime, event.time);
+        advanceBall(ball, currentTime);
+        ball.version++;
+
+        if (event.type == WALL_EVENT) {
+            processWall(ball, event.b);
+        } else if (event.type == CELL_EVENT) {
+            processCellCrossing(event.a, event.b);
+        } else {
+            EventBall& other = eventBalls[event.b];
+            advanceBall(other, currentTime);
+            other.version++;
+            processPair(ball, other);
+            predictBall(event.b);
+        }
+        predictBall(event.a);
+
+        if (++processed > budget) {
+            // Too many events this frame, most likely inelastic collapse:
+            // drift to the frame end and start over from the settled state
+            if (!budgetWarned) {
+                std::cerr << "Event budget exceeded, drifting to frame end" << std::endl;
+                budgetWarned = true;
+            }
+            break;
+        }
+    }
+    eventCount += processed;
+
+    currentTime = targetTime;
+    if (processed > budget) {
+        rebuildEvents();
+    } else if (events.size() > 16 * eventBalls.size() + 1024) {
+        // Drop stale events that piled up in the queue
+        rebuildEvents();
+    }
+
+    // Report every ball at the frame time
+    for (size_t i = 0; i < eventBalls.size(); i++) {
+        EventBall ball = eventBalls[i];
+        advanceBall(ball, currentTime);
+        snapshot[i].position.x = static_cast<float>(ball.x);
+        snapshot[i].position.y = static_cast<float>(ball.y);
+        snapshot[i].velocity.x = static_cast<float>(ball.vx);
+        snapshot[i].velocity.y = static_cast<float>(ball.vy);
+    }
+    return snapshot;
+}
+
+long long takeEventCount() {
+    long long count = eventCount;
+    eventCount = 0;
+    return count;
+}
\ No newline at end of file
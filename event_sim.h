@@ -0,0 +1,21 @@
+#ifndef EVENT_SIM_H
+#define EVENT_SIM_H
+
+#include <vector>
+#include "ball_def.h"
+
+// Event-driven simulation for dilute configurations
+// Balls move on exact ballistic paths between events; wall, pair and
+// broad-phase cell-crossing events are kept in a time-ordered queue and
+// the simulation jumps directly from one event to the next
+
+// Starts event-driven simulation from the given ball state
+void initEventSimulation(const std::vector<Ball>& balls);
+
+// Processes all events up to deltaTime ahead and returns ball state at that time
+const std::vector<Ball>& advanceEventSimulation(float deltaTime);
+
+// Returns the number of events processed since the last call
+long long takeEventCount();
+
+#endif // EVENT_SIM_H
\ No newline at end of file
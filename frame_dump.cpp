@@ -0,0 +1,339 @@
+#include "frame_dump.h"
+#include "simulation.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+// Default worker count cap; encoding beyond this rarely keeps up better
+const int MAX_DEFAULT_DUMP_THREADS = 4;
+
+// Slots per worker, so a worker never waits for the next readback
+const int DUMP_SLOTS_PER_THREAD = 2;
+
+// Fill alpha, as drawn on screen
+const float DUMP_FILL_ALPHA = 0.9f;
+
+// Frame size; the window's, so dumps match what would be on screen
+const int DUMP_WIDTH = WINDOW_WIDTH;
+const int DUMP_HEIGHT = WINDOW_HEIGHT;
+
+// zlib level for PNG frames; speed matters more than size for video frames
+const int PNG_COMPRESSION = Z_BEST_SPEED;
+
+// Snapshot in flight: filled by the device, then drawn and written by a worker
+struct DumpSlot {
+    std::vector<Ball> balls;
+    cl_event readEvent;
+    long long sequence;  // Frame index over the dump interval, numbering the output
+    bool busy;
+};
+
+std::vector<DumpSlot> slots;
+std::deque<int> filledSlots;  // Slots waiting for a worker, in frame order
+std::vector<std::thread> workers;
+std::mutex dumpMutex;
+std::condition_variable dumpWake;
+bool dumpStopping = false;
+bool dumping = false;
+std::string dumpDirectory;
+DumpFormat dumpFormat;
+int yuvFile = -1;
+long long writtenFrames = 0;
+long long droppedFrames = 0;
+double encodeSeconds = 0.0;
+
+// Draws balls over black into rgb (float RGB, row 0 at world y = 0)
+// Coverage and outline follow ball_sprite.frag, blended in ball order; the
+// world is stretched to the frame on each axis, so balls are ellipses
+void rasterizeBalls(const std::vector<Ball>& balls, std::vector<float>& rgb) {
+    std::fill(rgb.begin(), rgb.end(), 0.0f);
+    float scaleX = DUMP_WIDTH / config.worldWidth;
+    float scaleY = DUMP_HEIGHT / config.worldHeight;
+    for (size_t i = 0; i < balls.size(); i++) {
+        const Ball& ball = balls[i];
+        float centreX = ball.position.x * scaleX;
+        float centreY = ball.position.y * scaleY;
+        float radiusX = ball.radius * scaleX;
+        float radiusY = ball.radius * scaleY;
+        int x0 = std::max(0, static_cast<int>(std::floor(centreX - radiusX - 2.0f)));
+        int x1 = std::min(DUMP_WIDTH - 1, static_cast<int>(std::ceil(centreX + radiusX + 2.0f)));
+        int y0 = std::max(0, static_cast<int>(std::floor(centreY - radiusY - 2.0f)));
+        int y1 = std::min(DUMP_HEIGHT - 1, static_cast<int>(std::ceil(centreY + radiusY + 2.0f)));
+        int channel = static_cast<int>(i % 3);
+
+        for (int y = y0; y <= y1; y++) {
+            float dy = y + 0.5f - centreY;
+            for (int x = x0; x <= x1; x++) {
+                float dx = x + 0.5f - centreX;
+                // Pixels past the ellipse edge along the direction from the centre
+                float distance = std::sqrt(dx * dx + dy * dy);
+                float directionX = distance > 0.0f ? dx / distance : 1.0f;
+                float directionY = distance > 0.0f ? dy / distance : 0.0f;
+                float edge = distance - 1.0f / std::hypot(directionX / radiusX, directionY / radiusY);
+                float coverage = std::clamp(1.5f - edge, 0.0f, 1.0f);
+                if (coverage <= 0.0f) continue;
+                float outline = std::clamp(edge + 1.5f, 0.0f, 1.0f);
+                float alpha = (DUMP_FILL_ALPHA + (1.0f - DUMP_FILL_ALPHA) * outline) * coverage;
+
+                float* pixel = &rgb[3 * (static_cast<size_t>(y) * DUMP_WIDTH + x)];
+                pixel[0] *= 1.0f - alpha;
+                pixel[1] *= 1.0f - alpha;
+                pixel[2] *= 1.0f - alpha;
+                pixel[channel] += alpha;
+            }
+        }
+    }
+}
+
+unsigned char toByte(float value) {
+    return static_cast<unsigned char>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Appends a big-endian 32-bit value
+void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+// Appends a PNG chunk with its length and CRC
+void appendPngChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size) {
+    appendBigEndian(out, static_cast<uint32_t>(size));
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    uLong crc = crc32(0L, out.data() + typeStart, static_cast<uInt>(4 + size));
+    appendBigEndian(out, static_cast<uint32_t>(crc));
+}
+
+// Writes rgb as an 8-bit RGB PNG, unfiltered rows deflated by zlib
+void writePng(const std::vector<float>& rgb, long long sequence) {
+    size_t rowBytes = 1 + 3 * static_cast<size_t>(DUMP_WIDTH);
+    std::vector<unsigned char> rows(rowBytes * DUMP_HEIGHT);
+    for (int y = 0; y < DUMP_HEIGHT; y++) {
+        unsigned char* row = &rows[y * rowBytes];
+        row[0] = 0;  // Filter type None
+        for (int i = 0; i < 3 * DUMP_WIDTH; i++) {
+            row[1 + i] = toByte(rgb[3 * static_cast<size_t>(y) * DUMP_WIDTH + i]);
+        }
+    }
+    uLongf deflatedSize = compressBound(static_cast<uLong>(rows.size()));
+    std::vector<unsigned char> deflated(deflatedSize);
+    compress2(deflated.data(), &deflatedSize, rows.data(), static_cast<uLong>(rows.size()), PNG_COMPRESSION);
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<unsigned char> header;
+    appendBigEndian(header, DUMP_WIDTH);
+    appendBigEndian(header, DUMP_HEIGHT);
+    header.insert(header.end(), {8, 2, 0, 0, 0});  // 8-bit RGB, deflate, no filter choice, no interlace
+    appendPngChunk(png, "IHDR", header.data(), header.size());
+    appendPngChunk(png, "IDAT", deflated.data(), deflatedSize);
+    appendPngChunk(png, "IEND", nullptr, 0);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06lld.png", sequence);
+    std::string path = dumpDirectory + "/" + name;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(png.data()), png.size());
+    if (!out) {
+        std::cerr << "Failed to write frame: " << path << std::endl;
+    }
+}
+
+// Writes rgb as one I420 frame of frames.yuv, BT.601 limited range, with
+// chroma averaged over each 2x2 block
+void writeYuv(const std::vector<float>& rgb, long long sequence) {
+    size_t lumaSize = static_cast<size_t>(DUMP_WIDTH) * DUMP_HEIGHT;
+    size_t chromaSize = lumaSize / 4;
+    std::vector<unsigned char> frame(lumaSize + 2 * chromaSize);
+    unsigned char* luma = frame.data();
+    unsigned char* blue = luma + lumaSize;
+    unsigned char* red = blue + chromaSize;
+
+    for (size_t i = 0; i < lumaSize; i++) {
+        const float* pixel = &rgb[3 * i];
+        luma[i] = static_cast<unsigned char>(16.5f + 65.481f * pixel[0] + 128.553f * pixel[1] + 24.966f * pixel[2]);
+    }
+    for (int y = 0; y < DUMP_HEIGHT / 2; y++) {
+        for (int x = 0; x < DUMP_WIDTH / 2; x++) {
+            float r = 0.0f, g = 0.0f, b = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                const float* pixel = &rgb[3 * (static_cast<size_t>(2 * y + k / 2) * DUMP_WIDTH + 2 * x + k % 2)];
+                r += 0.25f * pixel[0];
+                g += 0.25f * pixel[1];
+                b += 0.25f * pixel[2];
+            }
+            size_t index = static_cast<size_t>(y) * (DUMP_WIDTH / 2) + x;
+            blue[index] = static_cast<unsigned char>(128.5f - 37.797f * r - 74.203f * g + 112.0f * b);
+            red[index] = static_cast<unsigned char>(128.5f + 112.0f * r - 93.786f * g - 18.214f * b);
+        }
+    }
+
+    off_t offset = static_cast<off_t>(sequence) * static_cast<off_t>(frame.size());
+    if (pwrite(yuvFile, frame.data(), frame.size(), offset) != static_cast<ssize_t>(frame.size())) {
+        std::cerr << "Failed to write frame " << sequence << " to frames.yuv" << std::endl;
+    }
+}
+
+// First slot no worker holds, or nullptr; call with dumpMutex held
+DumpSlot* findFreeSlot() {
+    for (DumpSlot& slot : slots) {
+        if (!slot.busy) return &slot;
+    }
+    return nullptr;
+}
+
+// Worker thread: waits for each readback, then draws and writes the frame
+void workerLoop(int worker) {
+    std::string threadName = "Frame dump " + std::to_string(worker);
+    nameTraceThread(threadName.c_str());
+    std::vector<float> rgb(3 * static_cast<size_t>(DUMP_WIDTH) * DUMP_HEIGHT);
+    std::unique_lock<std::mutex> lock(dumpMutex);
+    while (true) {
+        dumpWake.wait(lock, [] { return !filledSlots.empty() || dumpStopping; });
+        if (filledSlots.empty()) break;
+        DumpSlot& slot = slots[filledSlots.front()];
+        filledSlots.pop_front();
+        lock.unlock();
+
+        cl_int error;
+        {
+            TraceSpan span("wait for frame readback");
+            error = clWaitForEvents(1, &slot.readEvent);
+        }
+        clReleaseEvent(slot.readEvent);
+        double seconds = 0.0;
+        if (error == CL_SUCCESS) {
+            TraceSpan span("dump frame");
+            auto start = std::chrono::high_resolution_clock::now();
+            rasterizeBalls(slot.balls, rgb);
+            if (dumpFormat == DumpFormat::Png) {
+                writePng(rgb, slot.sequence);
+            } else {
+                writeYuv(rgb, slot.sequence);
+            }
+            seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        } else {
+            std::cerr << "Frame readback failed with error " << error << std::endl;
+        }
+
+        lock.lock();
+        slot.busy = false;
+        writtenFrames += error == CL_SUCCESS;
+        encodeSeconds += seconds;
+        dumpWake.notify_all();  // A headless frame loop may be waiting for the slot
+    }
+}
+
+}  // namespace
+
+void startFrameDump(const std::string& directory, DumpFormat format, int threads) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create frame dump directory: " << directory << std::endl;
+        exit(1);
+    }
+    dumpDirectory = directory;
+    dumpFormat = format;
+    if (format == DumpFormat::Yuv) {
+        std::string path = directory + "/frames.yuv";
+        yuvFile = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (yuvFile < 0) {
+            std::cerr << "Failed to open frame dump file: " << path << std::endl;
+            exit(1);
+        }
+    }
+
+    if (threads <= 0) {
+        threads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, MAX_DEFAULT_DUMP_THREADS);
+    }
+    slots.resize(threads * DUMP_SLOTS_PER_THREAD);
+    for (DumpSlot& slot : slots) {
+        slot.balls.resize(config.numBalls);
+        slot.busy = false;
+    }
+    writtenFrames = 0;
+    droppedFrames = 0;
+    encodeSeconds = 0.0;
+    dumpStopping = false;
+    dumping = true;
+    for (int worker = 0; worker < threads; worker++) {
+        workers.emplace_back(workerLoop, worker);
+    }
+    std::cout << "Dumping " << DUMP_WIDTH << "x" << DUMP_HEIGHT << " frames to " << directory << " on "
+              << threads << " threads" << std::endl;
+}
+
+void dumpFrame(long long frameIndex) {
+    if (!dumping) return;
+
+    DumpSlot* slot = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(dumpMutex);
+        slot = findFreeSlot();
+        if (!slot && config.headless) {
+            TraceSpan span("wait for dump slot");
+            dumpWake.wait(lock, [&] { return (slot = findFreeSlot()) != nullptr; });
+        }
+        if (!slot) {
+            droppedFrames++;
+            return;
+        }
+        slot->busy = true;
+        slot->sequence = frameIndex / config.dumpInterval;
+    }
+
+    cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_FALSE, 0, sizeof(Ball) * config.numBalls,
+                                       slot->balls.data(), 0, nullptr, &slot->readEvent);
+    checkError(error, "reading balls for frame dump");
+    clFlush(queue);
+
+    std::lock_guard<std::mutex> lock(dumpMutex);
+    filledSlots.push_back(static_cast<int>(slot - slots.data()));
+    dumpWake.notify_one();
+}
+
+void stopFrameDump() {
+    if (!dumping) return;
+    {
+        std::lock_guard<std::mutex> lock(dumpMutex);
+        dumpStopping = true;
+        dumpWake.notify_all();
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    slots.clear();
+    if (yuvFile >= 0) {
+        close(yuvFile);
+        yuvFile = -1;
+    }
+    dumping = false;
+
+    std::cout << "Frame dump: " << writtenFrames << " frames written to " << dumpDirectory;
+    if (droppedFrames > 0) {
+        std::cout << ", " << droppedFrames << " dropped while all slots were busy";
+    }
+    if (writtenFrames > 0) {
+        std::cout << ", " << 1000.0 * encodeSeconds / writtenFrames << " ms per frame";
+    }
+    std::cout << std::endl;
+}
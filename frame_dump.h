@@ -0,0 +1,33 @@
+#ifndef FRAME_DUMP_H
+#define FRAME_DUMP_H
+
+#include <string>
+#include "sim_config.h"
+
+// Frame dumps for making videos on nodes without a display
+// Dumped frames are drawn by a software rasterizer that shades each ball as
+// ball_sprite.frag does, at the window size, so no GL context is needed.
+// dumpFrame only enqueues a non-blocking readback of ballBuffer into a free
+// slot; a pool of worker threads waits for the readback, rasterizes and
+// encodes the frame and writes it out
+// Frames are numbered by frame index over the dump interval, so a dropped
+// frame leaves a gap: PNG frames go to DIR/frame_000000.png,
+// DIR/frame_000001.png, ...; raw YUV frames are written as 8-bit I420
+// (yuv420p, BT.601 limited range) to DIR/frames.yuv, each at the offset of
+// its number so workers may finish out of order
+
+// Creates the output directory and starts threads workers (0 picks one per
+// core, up to 4); call after the initial state is uploaded
+void startFrameDump(const std::string& directory, DumpFormat format, int threads);
+
+// Hands the current ballBuffer to the workers as frame frameIndex, which
+// must be a multiple of the dump interval. Headless runs wait for a free
+// slot, so every frame is written; windowed runs never block and drop the
+// frame if every slot is still being encoded
+void dumpFrame(long long frameIndex);
+
+// Writes the frames still in flight, stops the workers and reports the
+// frame count, dropped frames and encode time
+void stopFrameDump();
+
+#endif // FRAME_DUMP_H
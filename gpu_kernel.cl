@@ -1,68 +1,134 @@
 #include "ball_def.h"
 
-// Kernel for parallel position updates and wall collision detection
+// Kernel for parallel position updates
 // Simulates GPU-side data-parallel computation on M1 architecture
-__kernel void updateBallPositions(
-    __global Ball* balls,        // Array of all balls in simulation
-    const float deltaTime,       // Time step for physics update
-    const FLOAT2 boundaries,     // Window boundaries (width, height)
-    const int numBalls          // Total number of balls
+// Dispatched over the compacted list of moving balls
+__kernel void integrateBalls(
+    __global Ball* balls,              // Array of all balls in simulation
+    __global const int* movingList,    // Indices of balls that need integration
+    __global const int* activeCounts,  // Active list sizes written by compaction
+    const float deltaTime              // Time step for physics update
+) {
+    // Read list size on the device so the launch size is only a hint
+    int count = activeCounts[ACTIVE_MOVING];
+
+    for (int k = get_global_id(0); k < count; k += get_global_size(0)) {
+        // Load ball data into local memory for faster access
+        int gid = movingList[k];
+        Ball ball = balls[gid];
+
+        // Apply simplified gravity force
+        ball.velocity.y += GRAVITY * deltaTime;
+
+        // Limit maximum ball speed for stability
+        float speed = sqrt(ball.velocity.x * ball.velocity.x + ball.velocity.y * ball.velocity.y);
+        if (speed > MAX_SPEED) {
+            float scale = MAX_SPEED / speed;
+            ball.velocity.x *= scale;
+            ball.velocity.y *= scale;
+        }
+
+        // Update position using current velocity
+        ball.position.x += ball.velocity.x * deltaTime;
+        ball.position.y += ball.velocity.y * deltaTime;
+
+        // Write updated ball data back to global memory
+        balls[gid] = ball;
+    }
+}
+
+// Kernel for wall collision detection and response
+// Dispatched over the compacted list of balls near a wall
+__kernel void resolveWallCollisions(
+    __global Ball* balls,              // Array of all balls in simulation
+    __global const int* wallList,      // Indices of balls that may touch a wall
+    __global const int* activeCounts,  // Active list sizes written by compaction
+    const FLOAT2 boundaries            // Window boundaries (width, height)
+) {
+    int count = activeCounts[ACTIVE_WALL];
+
+    for (int k = get_global_id(0); k < count; k += get_global_size(0)) {
+        int gid = wallList[k];
+        Ball ball = balls[gid];
+        float radius = ball.radius;
+
+        // Wall collision response with energy loss factor
+        const float dampening = 0.7f;  // 30% energy loss on collision
+
+        // Check and respond to wall collisions
+        // Right wall collision
+        if (ball.position.x + radius > boundaries.x) {
+            ball.position.x = boundaries.x - radius;
+            ball.velocity.x = -fabs(ball.velocity.x) * dampening;
+        }
+        // Left wall collision
+        if (ball.position.x - radius < 0) {
+            ball.position.x = radius;
+            ball.velocity.x = fabs(ball.velocity.x) * dampening;
+        }
+
+        // Bottom wall collision
+        if (ball.position.y + radius > boundaries.y) {
+            ball.position.y = boundaries.y - radius;
+            ball.velocity.y = -fabs(ball.velocity.y) * dampening;
+        }
+        // Top wall collision
+        if (ball.position.y - radius < 0) {
+            ball.position.y = radius;
+            ball.velocity.y = fabs(ball.velocity.y) * dampening;
+        }
+
+        // Apply ground friction when ball is near bottom
+        if (fabs(ball.position.y - (boundaries.y - radius)) < 1.0f) {
+            ball.velocity.x *= 0.99f;  // 1% velocity loss per frame
+        }
+
+        balls[gid] = ball;
+    }
+}
+
+// Kernel that packs each ball's position, radius and colour for drawing
+// Writes the renderer's instance buffer in place when it is shared with OpenGL
+__kernel void writeBallVertices(
+    __global const Ball* balls,        // Array of all balls in simulation
+    __global float4* vertices,         // Per-ball (x, y, radius, colour index) instances
+    const int numBalls
 ) {
-    // Get this thread's ball index
     int gid = get_global_id(0);
     if (gid >= numBalls) return;
-    
-    // Load ball data into local memory for faster access
+
     Ball ball = balls[gid];
-    float radius = ball.radius;
-    
-    // Apply simplified gravity force (50 units/sec²)
-    ball.velocity.y += 50.0f * deltaTime;
-    
-    // Update position using current velocity
-    ball.position.x += ball.velocity.x * deltaTime;
-    ball.position.y += ball.velocity.y * deltaTime;
-    
-    // Wall collision response with energy loss factor
-    const float dampening = 0.7f;  // 30% energy loss on collision
-    
-    // Check and respond to wall collisions
-    // Right wall collision
-    if (ball.position.x + radius > boundaries.x) {
-        ball.position.x = boundaries.x - radius;
-        ball.velocity.x = -fabs(ball.velocity.x) * dampening;
-    }
-    // Left wall collision
-    if (ball.position.x - radius < 0) {
-        ball.position.x = radius;
-        ball.velocity.x = fabs(ball.velocity.x) * dampening;
-    }
-    
-    // Bottom wall collision
-    if (ball.position.y + radius > boundaries.y) {
-        ball.position.y = boundaries.y - radius;
-        ball.velocity.y = -fabs(ball.velocity.y) * dampening;
-    }
-    // Top wall collision
-    if (ball.position.y - radius < 0) {
-        ball.position.y = radius;
-        ball.velocity.y = fabs(ball.velocity.y) * dampening;
-    }
-    
-    // Apply ground friction when ball is near bottom
-    if (fabs(ball.position.y - (boundaries.y - radius)) < 1.0f) {
-        ball.velocity.x *= 0.99f;  // 1% velocity loss per frame
-    }
-    
-    // Limit maximum ball speed for stability
-    const float MAX_SPEED = 500.0f;
-    float speed = sqrt(ball.velocity.x * ball.velocity.x + ball.velocity.y * ball.velocity.y);
-    if (speed > MAX_SPEED) {
-        float scale = MAX_SPEED / speed;
-        ball.velocity.x *= scale;
-        ball.velocity.y *= scale;
+    vertices[gid] = (float4)(ball.position.x, ball.position.y, ball.radius, (float)(gid % 3));
+}
+
+// Kernel for level-of-detail drawing of very many balls
+// Balls narrower than minDiameter pixels on screen only add to the count of
+// the pixel holding their centre; larger ones are appended to the disc list
+__kernel void splatBalls(
+    __global const Ball* balls,        // Array of all balls in simulation
+    const int numBalls,
+    const FLOAT2 pixelScale,           // Screen pixels per world unit along x and y
+    const float minDiameter,           // Smallest ball drawn as a disc, in pixels
+    const int width,                   // Density image size in pixels
+    const int height,
+    __global int* density,             // Balls per pixel, cleared beforehand
+    __global float4* discs,            // Appended (x, y, radius, colour index) instances
+    __global int* discCount            // Disc list size, cleared beforehand
+) {
+    int gid = get_global_id(0);
+    if (gid >= numBalls) return;
+
+    // The world is stretched to the screen on each axis, so a ball is drawn
+    // as a disc when the longer axis of its ellipse reaches minDiameter
+    Ball ball = balls[gid];
+    if (2.0f * ball.radius * max(pixelScale.x, pixelScale.y) >= minDiameter) {
+        int slot = atomic_inc(discCount);
+        discs[slot] = (float4)(ball.position.x, ball.position.y, ball.radius, (float)(gid % 3));
+        return;
     }
-    
-    // Write updated ball data back to global memory
-    balls[gid] = ball;
-}
\ No newline at end of file
+
+    int x = (int)(ball.position.x * pixelScale.x);
+    int y = (int)(ball.position.y * pixelScale.y);
+    if (x < 0 || y < 0 || x >= width || y >= height) return;
+    atomic_inc(&density[y * width + x]);
+}
@@ -0,0 +1,89 @@
+#include "ball_def.h"
+
+// Initial state generation on the device
+// Every random value comes from Philox4x32-10 keyed by the seed, with the
+// ball index in the counter, so each ball depends only on (seed, index) and
+// the result is the same for any work-group or launch size
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// Counter words that select the stream a value is drawn from
+#define STREAM_MOTION 0u   // Jitter x, jitter y, velocity x, velocity y
+#define STREAM_SIZE 1u     // Radius choice
+#define STREAM_CELL 2u     // Feistel round keys of the cell permutation
+
+__constant float ballSizes[BALL_SIZE_COUNT] = BALL_SIZES;
+
+// Philox4x32 with 10 rounds (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3")
+uint4 philox4x32(uint4 counter, uint2 key) {
+    for (int round = 0; round < 10; round++) {
+        uint hi0 = mul_hi(PHILOX_M0, counter.x);
+        uint lo0 = PHILOX_M0 * counter.x;
+        uint hi1 = mul_hi(PHILOX_M1, counter.z);
+        uint lo1 = PHILOX_M1 * counter.z;
+        counter = (uint4)(hi1 ^ counter.y ^ key.x, lo1, hi0 ^ counter.w ^ key.y, lo0);
+        key += (uint2)(PHILOX_W0, PHILOX_W1);
+    }
+    return counter;
+}
+
+// Uniform float in [0, 1) from the top 24 bits
+float unitFloat(uint bits) {
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// Bijection on [0, 2^(2 * halfBits)): a four-round Feistel network
+uint feistel(uint value, const int halfBits, uint2 key) {
+    uint mask = (1u << halfBits) - 1u;
+    uint left = value >> halfBits;
+    uint right = value & mask;
+    for (uint round = 0; round < 4; round++) {
+        uint mixed = philox4x32((uint4)(right, round, STREAM_CELL, 0u), key).x & mask;
+        uint next = left ^ mixed;
+        left = right;
+        right = next;
+    }
+    return (left << halfBits) | right;
+}
+
+// Random permutation of [0, cellCount): cycle-walks the Feistel network until
+// it lands inside the range, which keeps it a bijection
+uint permuteCell(uint index, const uint cellCount, const int halfBits, uint2 key) {
+    uint cell = index;
+    do {
+        cell = feistel(cell, halfBits, key);
+    } while (cell >= cellCount);
+    return cell;
+}
+
+// Places each ball in its own placement cell of a columns-wide grid,
+// jittered inside the part of the cell it fits in, with a random velocity
+__kernel void generateBalls(
+    __global Ball* balls,          // Array of all balls in simulation
+    const int numBalls,            // Total number of balls
+    const uint2 seed,              // Philox key
+    const int columns,             // Placement grid width in cells
+    const uint cellCount,          // Placement cells, at least numBalls
+    const int halfBits,            // Half the bit width of the permutation domain
+    const float cellSize,          // Placement cell width
+    const float maxVelocity        // Bound of each initial velocity component
+) {
+    for (int i = get_global_id(0); i < numBalls; i += get_global_size(0)) {
+        uint4 motion = philox4x32((uint4)((uint)i, STREAM_MOTION, 0u, 0u), seed);
+        uint size = philox4x32((uint4)((uint)i, STREAM_SIZE, 0u, 0u), seed).x;
+        uint cell = permuteCell((uint)i, cellCount, halfBits, seed);
+
+        Ball ball;
+        ball.radius = ballSizes[size % BALL_SIZE_COUNT];
+        float slack = cellSize - 2.0f * ball.radius;
+        ball.position.x = (cell % columns) * cellSize + ball.radius + unitFloat(motion.x) * slack;
+        ball.position.y = (cell / columns) * cellSize + ball.radius + unitFloat(motion.y) * slack;
+        ball.velocity.x = (2.0f * unitFloat(motion.z) - 1.0f) * maxVelocity;
+        ball.velocity.y = (2.0f * unitFloat(motion.w) - 1.0f) * maxVelocity;
+        ball.padding = 0.0f;
+        balls[i] = ball;
+    }
+}
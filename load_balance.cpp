@@ -0,0 +1,79 @@
+#include "load_balance.h"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+// Strip holding x; balls outside the world belong to the edge strips
+int stripOf(const std::vector<float>& edges, float x) {
+    int strip = static_cast<int>(std::upper_bound(edges.begin(), edges.end(), x) - edges.begin()) - 1;
+    return std::clamp(strip, 0, static_cast<int>(edges.size()) - 2);
+}
+
+}  // namespace
+
+std::vector<float> balanceStripEdges(const std::vector<Ball>& balls, const std::vector<float>& edges,
+                                     const std::vector<double>& stepTimes, float minWidth) {
+    int parts = static_cast<int>(edges.size()) - 1;
+    if (parts < 2 || balls.empty()) return edges;
+
+    // Cost per ball of each strip; empty strips take the average
+    std::vector<int> counts(parts, 0);
+    for (const Ball& ball : balls) {
+        counts[stripOf(edges, ball.position.x)]++;
+    }
+    double totalTime = std::accumulate(stepTimes.begin(), stepTimes.end(), 0.0);
+    if (!(totalTime > 0.0)) return edges;
+    double averageCost = totalTime / balls.size();
+    std::vector<double> ballCost(parts);
+    for (int p = 0; p < parts; p++) {
+        ballCost[p] = counts[p] > 0 ? stepTimes[p] / counts[p] : averageCost;
+    }
+
+    // Cut the balls, in x order, into runs of equal total cost
+    std::vector<std::pair<float, double>> weighted(balls.size());
+    for (size_t i = 0; i < balls.size(); i++) {
+        float x = balls[i].position.x;
+        weighted[i] = {x, ballCost[stripOf(edges, x)]};
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    std::vector<float> balanced(edges);
+    double totalCost = 0.0;
+    for (const auto& entry : weighted) {
+        totalCost += entry.second;
+    }
+    double cumulative = 0.0;
+    int next = 1;
+    for (size_t i = 0; i + 1 < weighted.size() && next < parts; i++) {
+        cumulative += weighted[i].second;
+        while (next < parts && cumulative >= totalCost * next / parts) {
+            // Cut midway between neighbouring balls
+            balanced[next++] = 0.5f * (weighted[i].first + weighted[i + 1].first);
+        }
+    }
+    while (next < parts) {
+        balanced[next++] = weighted.back().first;
+    }
+
+    // Keep inner edges inside the world and strips at least minWidth wide,
+    // pushing forwards and then backwards from the fixed outer edges
+    for (int p = 1; p < parts; p++) {
+        balanced[p] = std::max(balanced[p], balanced[p - 1] + minWidth);
+    }
+    for (int p = parts - 1; p >= 1; p--) {
+        balanced[p] = std::min(balanced[p], balanced[p + 1] - minWidth);
+    }
+    return balanced;
+}
+
+void reportStripEdges(const char* label, const std::vector<float>& edges, const std::vector<double>& stepTimes) {
+    double totalTime = std::accumulate(stepTimes.begin(), stepTimes.end(), 0.0);
+    std::cout << "Rebalanced " << label << ":";
+    for (size_t p = 0; p + 1 < edges.size(); p++) {
+        std::cout << " [" << edges[p] << ", " << edges[p + 1] << ") "
+                  << static_cast<int>(100.0 * stepTimes[p] / totalTime + 0.5) << "%";
+    }
+    std::cout << std::endl;
+}
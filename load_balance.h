@@ -0,0 +1,23 @@
+#ifndef LOAD_BALANCE_H
+#define LOAD_BALANCE_H
+
+#include <vector>
+#include "ball_def.h"
+
+// Load balancing of the vertical strips shared by --devices and MPI runs
+// Each partition's measured step time is spread evenly over the balls it
+// owned, which gives every ball a cost. The strip edges are then moved so
+// that every strip holds an equal share of the total cost. Dense piles thus
+// end up in narrow strips and sparse gas in wide ones, and a partition on a
+// slower device is given fewer balls
+
+// Returns new edges for the strips [edges[p], edges[p + 1]), given the time
+// each strip spent stepping since the last rebalance
+// The outer edges stay put, and inner strips are kept at least minWidth wide
+std::vector<float> balanceStripEdges(const std::vector<Ball>& balls, const std::vector<float>& edges,
+                                     const std::vector<double>& stepTimes, float minWidth);
+
+// Prints the new strip edges and each strip's share of the measured time
+void reportStripEdges(const char* label, const std::vector<float>& edges, const std::vector<double>& stepTimes);
+
+#endif // LOAD_BALANCE_H
@@ -1,145 +1,65 @@
-#include <OpenCL/cl.h>
 #include <GLFW/glfw3.h>
 #include <vector>
 #include <random>
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <cmath>
-#include "ball_def.h"
-
-// Global Constants for Simulation
-const int NUM_BALLS = 30;
-const int WINDOW_WIDTH = 800;
-const int WINDOW_HEIGHT = 600;
-const float MIN_RADIUS = 15.0f;    
-const float MAX_RADIUS = 25.0f;   
-const float MAX_INITIAL_VELOCITY = 500.0f;
-
-// OpenCL Core Components
-// Note: On M1, these components simulate CPU/GPU separation
-// though they run on the unified processor
-cl_platform_id platform;
-cl_device_id device;
-cl_context context;
-cl_command_queue queue;
-cl_program program;
-cl_kernel gpuKernel, cpuKernel;  // Separate kernels simulate CPU/GPU tasks
-cl_mem ballBuffer, vertexBuffer, statsBuffer;
+#include <atomic>
+#include <csignal>
+#include <thread>
+#include "simulation.h"
+#include "sim_config.h"
+#include "event_sim.h"
+#include "checkpoint.h"
+#include "trajectory.h"
+#include "replay.h"
+#include "placement.h"
+#include "domain.h"
+#include "distributed.h"
+#include "trace.h"
+#include "metrics.h"
+#include "renderer.h"
+#include "frame_dump.h"
+#include "triple_buffer.h"
 
 // Main GLFW Window Handle
 GLFWwindow* window = nullptr;
 
-// Reads kernel source file into string
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filename);
-    }
-    return std::string(std::istreambuf_iterator<char>(file),
-                      std::istreambuf_iterator<char>());
-}
+// Frames between ball readbacks for the kinetic energy metric when drawing
+// from shared instances or level-of-detail views, which read back no balls
+const int SHARED_ENERGY_INTERVAL = 30;
 
-// Handles OpenCL errors with descriptive messages
-void checkError(cl_int error, const char* operation) {
-    if (error != CL_SUCCESS) {
-        std::cerr << "Error during operation " << operation << ": " << error << std::endl;
-        exit(1);
-    }
-}
+// Simulated seconds per frame without a window, where frames are not paced
+// by the display; dumping every other frame then gives 30 fps real-time video
+const float HEADLESS_TIME_STEP = 1.0f / 60.0f;
 
-// Sets up OpenCL environment and creates kernels
-// For M1: Uses CL_DEVICE_TYPE_DEFAULT instead of separate CPU/GPU devices
-void initOpenCL() {
-    cl_int error;
-
-    // Get platform
-    cl_uint numPlatforms;
-    error = clGetPlatformIDs(1, &platform, &numPlatforms);
-    checkError(error, "getting platform ID");
-
-    // Print platform info for debugging
-    char platformName[128];
-    error = clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof(platformName), 
-                             platformName, nullptr);
-    checkError(error, "getting platform info");
-    std::cout << "OpenCL Platform: " << platformName << std::endl;
-
-    // M1 Configuration: Use default device type
-    error = clGetDeviceIDs(platform, CL_DEVICE_TYPE_DEFAULT, 1, &device, nullptr);
-    checkError(error, "getting device");
-
-    // Print device info for debugging
-    char deviceName[128];
-    error = clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), 
-                           deviceName, nullptr);
-    checkError(error, "getting device info");
-    std::cout << "OpenCL Device: " << deviceName << std::endl;
-
-    // Create OpenCL context
-    cl_context_properties properties[] = {
-        CL_CONTEXT_PLATFORM, (cl_context_properties)platform,
-        0
-    };
-    context = clCreateContext(properties, 1, &device, nullptr, nullptr, &error);
-    checkError(error, "creating context");
-
-    // Create command queue for kernel execution
-    queue = clCreateCommandQueue(context, device, 0, &error);
-    checkError(error, "creating command queue");
-
-    // Load and combine kernel source with header
-    std::string headerContent = readFile("ball_def.h");
-    std::string gpuSource = readFile("gpu_kernel.cl");
-    std::string cpuSource = readFile("cpu_kernel.cl");
-    
-    std::string combinedGPUSource = headerContent + "\n" + gpuSource;
-    std::string combinedCPUSource = headerContent + "\n" + cpuSource;
-    
-    // Create and build position update kernel (simulated GPU work)
-    const char* gpuSrc = combinedGPUSource.c_str();
-    size_t gpuLen = combinedGPUSource.length();
-    cl_program gpuProgram = clCreateProgramWithSource(context, 1, &gpuSrc, &gpuLen, &error);
-    checkError(error, "creating GPU program");
-    
-    error = clBuildProgram(gpuProgram, 0, nullptr, nullptr, nullptr, nullptr);
-    if (error != CL_SUCCESS) {
-        size_t len;
-        char buffer[2048];
-        clGetProgramBuildInfo(gpuProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-        std::cerr << "GPU Build error: " << buffer << std::endl;
-        exit(1);
-    }
-    
-    // Create and build collision detection kernel (simulated CPU work)
-    const char* cpuSrc = combinedCPUSource.c_str();
-    size_t cpuLen = combinedCPUSource.length();
-    cl_program cpuProgram = clCreateProgramWithSource(context, 1, &cpuSrc, &cpuLen, &error);
-    checkError(error, "creating CPU program");
-    
-    error = clBuildProgram(cpuProgram, 0, nullptr, nullptr, nullptr, nullptr);
-    if (error != CL_SUCCESS) {
-        size_t len;
-        char buffer[2048];
-        clGetProgramBuildInfo(cpuProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-        std::cerr << "CPU Build error: " << buffer << std::endl;
-        exit(1);
-    }
+// Set by SIGINT or SIGTERM in headless runs, which have no window to close
+volatile std::sig_atomic_t stopRequested = 0;
 
-    // Create kernels for position updates and collision detection
-    gpuKernel = clCreateKernel(gpuProgram, "updateBallPositions", &error);
-    checkError(error, "creating GPU kernel");
-    cpuKernel = clCreateKernel(cpuProgram, "checkBallCollisions", &error);
-    checkError(error, "creating CPU kernel");
+// What drawing a frame needs from the device: the balls, or a
+// level-of-detail view of them
+struct FrameSnapshot {
+    std::vector<Ball> balls;
+    std::vector<cl_int> lodDensity;
+    std::vector<cl_float4> lodDiscs;
+};
 
-    // Create memory buffers
-    ballBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(Ball) * NUM_BALLS, nullptr, &error);
-    checkError(error, "creating ball buffer");
-    vertexBuffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(cl_float4) * NUM_BALLS, nullptr, &error);
-    checkError(error, "creating vertex buffer");
-    statsBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), nullptr, &error);
-    checkError(error, "creating stats buffer");
-}
+// Settings of this run, fixed before the frame loop starts
+struct LoopSettings {
+    bool root;
+    bool distributed;
+    bool windowed;      // Rank 0 with a window
+    bool renderThread;  // The main thread draws while another one steps
+};
+
+// Snapshots from the simulation thread to the render thread
+TripleBuffer<FrameSnapshot> snapshots;
+std::atomic<bool> windowClosed{false};        // Set by the render thread
+std::atomic<bool> simulationFinished{false};  // Set by the simulation thread
+std::atomic<int> framesDrawn{0};
+
+// Random number generator for initial state, saved with checkpoints
+std::mt19937 rng{std::random_device{}()};
 
 // Initializes GLFW window and OpenGL settings
 void initGraphics() {
@@ -168,7 +88,7 @@ void initGraphics() {
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    glOrtho(0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, -1, 1);
+    glOrtho(0, config.worldWidth, config.worldHeight, 0, -1, 1);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
     
@@ -176,189 +96,306 @@ void initGraphics() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_MULTISAMPLE);
+
+    initBallRenderer();
 }
 
-// Creates initial ball population with random properties
+// Creates initial ball population with random, non-overlapping placement,
+// generated on the device unless --host-init is given
 void initBalls() {
-    std::vector<Ball> balls(NUM_BALLS);
-    
-    // Random number generation setup
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> radiusDist(MIN_RADIUS, MAX_RADIUS);
-    std::uniform_real_distribution<float> posDist(0.0f, 1.0f);
-    std::uniform_real_distribution<float> velDist(-MAX_INITIAL_VELOCITY, MAX_INITIAL_VELOCITY);
-    
-    // Available ball sizes
-    const float radii[3] = {15.0f, 20.0f, 25.0f};
-    
-    // Initialize each ball
-    for (int i = 0; i < NUM_BALLS; i++) {
-        int radiusIndex = gen() % 3;
-        balls[i].radius = radii[radiusIndex];
-        
-        balls[i].position.x = balls[i].radius + 
-            posDist(gen) * (WINDOW_WIDTH - 2 * balls[i].radius);
-        balls[i].position.y = balls[i].radius + 
-            posDist(gen) * (WINDOW_HEIGHT - 2 * balls[i].radius);
-        
-        balls[i].velocity.x = velDist(gen);
-        balls[i].velocity.y = velDist(gen);
+    std::vector<Ball> balls;
+    if (config.hostInit) {
+        placeBalls(balls, rng);
+        cl_int error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0, 
+                                           sizeof(Ball) * config.numBalls, balls.data(), 
+                                           0, nullptr, nullptr);
+        checkError(error, "writing initial ball data");
+    } else {
+        // The device key is drawn from rng so checkpoints and --seed cover it;
+        // separate draws fix the order, which operands of | leave unspecified
+        cl_ulong high = rng();
+        cl_ulong low = rng();
+        cl_ulong seed = (high << 32) | low;
+        generateBallsOnDevice(seed);
+    }
 
-        // Debug output
-        std::cout << "Ball " << i << " initialized: pos=(" 
-                  << balls[i].position.x << "," << balls[i].position.y 
-                  << "), vel=(" << balls[i].velocity.x << "," << balls[i].velocity.y 
-                  << "), radius=" << balls[i].radius << std::endl;
+    // Per-ball output is opt-in; at large ball counts it dominates startup
+    if (config.logBalls) {
+        if (!config.hostInit) {
+            balls.resize(config.numBalls);
+            cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                              sizeof(Ball) * config.numBalls, balls.data(),
+                                              0, nullptr, nullptr);
+            checkError(error, "reading initial ball data");
+        }
+        for (int i = 0; i < config.numBalls; i++) {
+            std::cout << "Ball " << i << " initialized: pos=("
+                      << balls[i].position.x << "," << balls[i].position.y
+                      << "), vel=(" << balls[i].velocity.x << "," << balls[i].velocity.y
+                      << "), radius=" << balls[i].radius << '\n';
+        }
+        std::cout.flush();
     }
+}
 
-    // Upload initial ball data to OpenCL buffer
-    cl_int error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0, 
-                                       sizeof(Ball) * NUM_BALLS, balls.data(), 
-                                       0, nullptr, nullptr);
-    checkError(error, "writing initial ball data");
+// Waits for the frame's draws and shows it
+void presentFrame() {
+    {
+        TraceSpan span("glFinish");
+        glFinish();
+    }
+    TraceSpan span("swap");
+    glfwSwapBuffers(window);
 }
 
-// Renders current frame with anti-aliased balls
-void render() {
+// Draws a frame of anti-aliased balls; with shared instances they come
+// straight from OpenCL and balls is ignored
+void drawBalls(const std::vector<Ball>& balls) {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
-    
-    // Get current ball positions from OpenCL
-    std::vector<Ball> balls(NUM_BALLS);
+    {
+        TraceSpan span("draw");
+        if (ballInstancesShared()) {
+            drawSharedBallBatch(config.numBalls);
+        } else {
+            drawBallBatch(balls);
+        }
+    }
+    presentFrame();
+}
+
+// Draws the balls as a per-pixel heat map plus circles for the larger ones
+void drawLodBalls(const FrameSnapshot& frame) {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    {
+        TraceSpan span("draw");
+        drawLodFrame(frame.lodDensity, WINDOW_WIDTH, WINDOW_HEIGHT, frame.lodDiscs);
+    }
+    presentFrame();
+}
+
+// Reads the current ball state back from OpenCL
+void readBalls(std::vector<Ball>& balls) {
+    TraceSpan span("read back");
+    balls.resize(config.numBalls);
     cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0,
-                                      sizeof(Ball) * NUM_BALLS, balls.data(),
+                                      sizeof(Ball) * config.numBalls, balls.data(),
                                       0, nullptr, nullptr);
     checkError(error, "reading ball data for rendering");
-    
-    // Ball color definitions
-    const float colors[3][3] = {
-        {1.0f, 0.0f, 0.0f},  // Red
-        {0.0f, 1.0f, 0.0f},  // Green
-        {0.0f, 0.0f, 1.0f}   // Blue
-    };
-    
-    // Enable anti-aliasing
-    glEnable(GL_POINT_SMOOTH);
-    glEnable(GL_LINE_SMOOTH);
-    glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-    
-    // Draw all balls
-    for (int i = 0; i < NUM_BALLS; i++) {
-        const Ball& ball = balls[i];
-        const int colorIndex = i % 3;
-        const int segments = 32;
-        
-        // Draw filled circle
-        glColor4f(colors[colorIndex][0], colors[colorIndex][1], colors[colorIndex][2], 0.9f);
-        glBegin(GL_TRIANGLE_FAN);
-        glVertex2f(ball.position.x, ball.position.y);
-        for (int j = 0; j <= segments; j++) {
-            float angle = 2.0f * M_PI * j / segments;
-            float x = ball.position.x + cos(angle) * ball.radius;
-            float y = ball.position.y + sin(angle) * ball.radius;
-            glVertex2f(x, y);
-        }
-        glEnd();
-        
-        // Draw circle outline
-        glColor4f(colors[colorIndex][0], colors[colorIndex][1], colors[colorIndex][2], 1.0f);
-        glLineWidth(2.0f);
-        glBegin(GL_LINE_LOOP);
-        for (int j = 0; j < segments; j++) {
-            float angle = 2.0f * M_PI * j / segments;
-            float x = ball.position.x + cos(angle) * ball.radius;
-            float y = ball.position.y + sin(angle) * ball.radius;
-            glVertex2f(x, y);
-        }
-        glEnd();
+}
+
+// Reads back what drawing the current state needs: a level-of-detail view,
+// which reads one count per window pixel instead of every ball, nothing
+// with shared instances, and otherwise the balls; frame.balls is left empty
+// unless the balls were read
+void readFrame(FrameSnapshot& frame) {
+    frame.balls.clear();
+    if (config.renderMode == RenderMode::Lod) {
+        TraceSpan span("read level of detail");
+        readLodView(WINDOW_WIDTH, WINDOW_HEIGHT, config.lodPixels, frame.lodDensity, frame.lodDiscs);
+    } else if (!ballInstancesShared()) {
+        readBalls(frame.balls);
     }
-    
-    glFinish();
-    glfwSwapBuffers(window);
 }
 
-// Releases OpenCL and GLFW resources
-void cleanup() {
-    clReleaseMemObject(ballBuffer);
-    clReleaseMemObject(vertexBuffer);
-    clReleaseMemObject(statsBuffer);
-    clReleaseKernel(gpuKernel);
-    clReleaseKernel(cpuKernel);
-    clReleaseProgram(program);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(context);
+// Draws a frame read by readFrame
+void drawFrame(const FrameSnapshot& frame) {
+    if (config.renderMode == RenderMode::Lod) {
+        drawLodBalls(frame);
+    } else {
+        drawBalls(frame.balls);
+    }
+}
+
+// Renders current frame from the simulation state
+void render(FrameSnapshot& frame) {
+    TraceSpan span("render");
+    readFrame(frame);
+    drawFrame(frame);
+}
+
+// Replay controls: space pauses, left/right seek 5 s, up/down double or
+// halve the speed, R reverses, Home/End jump to either end
+void replayKeyCallback(GLFWwindow*, int key, int, int action, int) {
+    if (action != GLFW_PRESS && action != GLFW_REPEAT) return;
+    switch (key) {
+        case GLFW_KEY_SPACE: toggleReplayPause(); break;
+        case GLFW_KEY_LEFT: seekReplay(replayTime() - 5.0); break;
+        case GLFW_KEY_RIGHT: seekReplay(replayTime() + 5.0); break;
+        case GLFW_KEY_UP: setReplaySpeed(replaySpeed() * 2.0); break;
+        case GLFW_KEY_DOWN: setReplaySpeed(replaySpeed() * 0.5); break;
+        case GLFW_KEY_R: setReplaySpeed(-replaySpeed()); break;
+        case GLFW_KEY_HOME: seekReplay(0.0); break;
+        case GLFW_KEY_END: seekReplay(1.0e300); break;
+        default: return;
+    }
+    std::cout << "Replay t=" << replayTime() << ", speed " << replaySpeed() << "x" << std::endl;
+}
+
+// Plays back a recorded trajectory; neither kernel runs and OpenCL is not set up
+void runReplay() {
+    openReplay(config.replayPath);
+    setReplaySpeed(config.replaySpeed);
+    initGraphics();
+    glfwSetKeyCallback(window, replayKeyCallback);
+
+    auto lastTime = std::chrono::high_resolution_clock::now();
+    while (!glfwWindowShouldClose(window)) {
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
+        lastTime = currentTime;
+
+        drawBalls(advanceReplay(deltaTime));
+        glfwPollEvents();
+    }
+
+    closeReplay();
+    cleanupBallRenderer();
     glfwDestroyWindow(window);
     glfwTerminate();
 }
 
-// Main simulation loop and program entry point
-int main() {
-    // Initialize systems in required order
-    initOpenCL();
-    initGraphics();  // Must follow OpenCL init
-    initBalls();
+// Lets a headless run finish its outputs when interrupted
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Releases OpenCL and GLFW resources
+void cleanup() {
+    cleanupOpenCL();
+    if (window) {
+        cleanupBallRenderer();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+}
+
+// Steps the simulation until the window closes, --frames is reached or a
+// headless run is interrupted, feeding checkpoints, trajectories, frame
+// dumps, metrics and the display; on every rank
+void simulationLoop(const LoopSettings& run, double& simulationTime) {
+    if (run.renderThread) {
+        nameTraceThread("Simulation");
+    }
 
     // Timing variables for frame rate control
     auto lastTime = std::chrono::high_resolution_clock::now();
     int frameCount = 0;
+    long long frameIndex = 0;
     auto lastFPSTime = lastTime;
-    
-    // Main simulation loop
-    while (!glfwWindowShouldClose(window)) {
+    FrameSnapshot frame;
+
+    while (true) {
         // Calculate frame timing
         auto currentTime = std::chrono::high_resolution_clock::now();
         float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
         lastTime = currentTime;
 
+        if (config.headless) deltaTime = HEADLESS_TIME_STEP;
+
         // Limit maximum time step to prevent simulation instability
-        if (deltaTime > 0.05f) deltaTime = 0.05f;
+        if (deltaTime > config.maxTimeStep) deltaTime = config.maxTimeStep;
+
+        // Every rank steps with rank 0's time step and stops with its window,
+        // or after --frames
+        bool running = true;
+        if (run.renderThread) {
+            running = !windowClosed;
+        } else if (run.windowed) {
+            running = !glfwWindowShouldClose(window);
+        } else if (run.root) {
+            running = !stopRequested;
+        }
+        if (config.maxFrames > 0 && frameIndex >= config.maxFrames) running = false;
+        if (run.distributed) {
+            running = syncDistributedFrame(deltaTime, running);
+        }
+        if (!running) break;
         
         // Calculate and display FPS every second
         frameCount++;
         auto fpsDuration = std::chrono::duration<float>(currentTime - lastFPSTime).count();
-        if (fpsDuration >= 1.0f) {
+        if (run.root && fpsDuration >= 1.0f) {
             float fps = frameCount / fpsDuration;
-            std::cout << "FPS: " << fps << ", Delta Time: " << deltaTime << std::endl;
+            std::cout << "FPS: " << fps << ", Delta Time: " << deltaTime;
+            if (run.renderThread) {
+                std::cout << ", Drawn FPS: " << framesDrawn.exchange(0) / fpsDuration;
+            }
+            if (config.eventDriven) {
+                std::cout << ", Events/s: " << takeEventCount() / fpsDuration;
+            }
+            std::cout << std::endl;
             frameCount = 0;
             lastFPSTime = currentTime;
         }
 
-        // Reset collision detection counter
-        int zero = 0;
-        cl_int error = clEnqueueWriteBuffer(queue, statsBuffer, CL_TRUE, 0, 
-                                          sizeof(int), &zero, 0, nullptr, nullptr);
-        checkError(error, "clearing stats buffer");
-
-        // Simulate GPU work: Update ball positions in parallel
-        // On M1, this runs on unified memory but simulates GPU parallel processing
-        FLOAT2 boundaries = {static_cast<float>(WINDOW_WIDTH), 
-                           static_cast<float>(WINDOW_HEIGHT)};
-        error = clSetKernelArg(gpuKernel, 0, sizeof(cl_mem), &ballBuffer);
-        error |= clSetKernelArg(gpuKernel, 1, sizeof(float), &deltaTime);
-        error |= clSetKernelArg(gpuKernel, 2, sizeof(FLOAT2), &boundaries);
-        error |= clSetKernelArg(gpuKernel, 3, sizeof(int), &NUM_BALLS);
-        checkError(error, "setting GPU kernel arguments");
-        
-        size_t globalSize = NUM_BALLS;
-        error = clEnqueueNDRangeKernel(queue, gpuKernel, 1, nullptr, &globalSize, 
-                                      nullptr, 0, nullptr, nullptr);
-        checkError(error, "enqueueing GPU kernel");
-
-        // Simulate CPU work: Process ball collisions
-        // On M1, this runs on same processor but simulates CPU task parallelism
-        error = clSetKernelArg(cpuKernel, 0, sizeof(cl_mem), &ballBuffer);
-        error |= clSetKernelArg(cpuKernel, 1, sizeof(int), &NUM_BALLS);
-        error |= clSetKernelArg(cpuKernel, 2, sizeof(cl_mem), &statsBuffer);
-        checkError(error, "setting CPU kernel arguments");
-        
-        error = clEnqueueNDRangeKernel(queue, cpuKernel, 1, nullptr, &globalSize, 
-                                      nullptr, 0, nullptr, nullptr);
-        checkError(error, "enqueueing CPU kernel");
+        if (config.eventDriven) {
+            // Advance on the host and upload the result for rendering
+            TraceSpan span("event-driven step");
+            const std::vector<Ball>& balls = advanceEventSimulation(deltaTime);
+            cl_int error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                               sizeof(Ball) * config.numBalls, balls.data(),
+                                               0, nullptr, nullptr);
+            checkError(error, "writing event-driven ball data");
+        } else if (config.devices > 1) {
+            // Step the strips on their devices and gather the world for rendering
+            TraceSpan span("strip step");
+            const std::vector<Ball>& balls = advanceDomainSimulation(deltaTime);
+            cl_int error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                               sizeof(Ball) * config.numBalls, balls.data(),
+                                               0, nullptr, nullptr);
+            checkError(error, "writing decomposed ball data");
+        } else if (run.distributed) {
+            // Step this rank's slab and gather the world on rank 0 for rendering
+            TraceSpan span("slab step");
+            advanceDistributedSimulation(deltaTime);
+            const std::vector<Ball>& balls = gatherDistributedWorld();
+            if (run.root) {
+                cl_int error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                                   sizeof(Ball) * config.numBalls, balls.data(),
+                                                   0, nullptr, nullptr);
+                checkError(error, "writing distributed ball data");
+            }
+        } else {
+            // Enqueue this frame's simulation kernels
+            TraceSpan span("enqueue frame");
+            simulateFrame(deltaTime);
+        }
+        simulationTime += deltaTime;
+        frameIndex++;
+        if (!run.root) continue;
+
+        // Periodic checkpoint, read back and written in the background
+        if (config.checkpointInterval > 0 && frameIndex % config.checkpointInterval == 0) {
+            TraceSpan span("request checkpoint");
+            requestCheckpoint(config.checkpointPath, simulationTime, rng, false);
+        }
+        if (!config.trajectoryPath.empty() && frameIndex % config.trajectoryInterval == 0) {
+            TraceSpan span("record trajectory");
+            recordTrajectoryFrame(frameIndex, simulationTime);
+        }
+        if (!config.dumpPath.empty() && frameIndex % config.dumpInterval == 0) {
+            TraceSpan span("dump frame");
+            dumpFrame(frameIndex);
+        }
+
+        // Pack the balls into the shared instance buffer for drawing
+        if (ballInstancesShared()) {
+            TraceSpan span("update vertices");
+            enqueueVertexUpdate();
+        }
 
         // Synchronize simulated CPU/GPU work
-        clFinish(queue);
+        {
+            TraceSpan span("clFinish");
+            clFinish(queue);
+        }
+        std::vector<KernelInterval> kernelIntervals;
+        if (config.profileKernels) {
+            kernelIntervals = takeKernelIntervals();
+            traceKernelIntervals(kernelIntervals);
+        }
 
         // Process collision statistics
         // int collisionCount;
@@ -368,13 +405,239 @@ int main() {
         //     std::cout << "Collisions this frame: " << collisionCount << std::endl;
         // }
 
-        // Update display with new frame
-        render();
-        
+        // Update display with new frame; the render thread is handed a new
+        // snapshot whenever it has taken the last one, and draws at its own pace
+        FrameSnapshot* snapshot = nullptr;
+        if (run.renderThread) {
+            frame.balls.clear();
+            if (!snapshots.unread()) {
+                snapshot = &snapshots.back();
+                readFrame(*snapshot);
+            }
+        } else if (run.windowed) {
+            render(frame);
+        } else {
+            frame.balls.clear();
+        }
+        std::vector<Ball>& frameBalls = snapshot ? snapshot->balls : frame.balls;
+
+        // Only the main pipeline builds active lists, and only the coloured
+        // and Jacobi solvers fill the contact list
+        if (metricsEnabled()) {
+            FrameMetrics metrics{simulationTime, -1, -1, 0.0, static_cast<int>(kernelIntervals.size()), {}};
+            if (!config.eventDriven && config.devices == 1 && !run.distributed) {
+                int activeCounts[ACTIVE_LIST_COUNT];
+                readActiveListSizes(activeCounts);
+                metrics.activeBalls = activeCounts[ACTIVE_MOVING];
+                if (config.solver != SolverMode::Sequential) {
+                    metrics.contacts = activeCounts[ACTIVE_PAIRS];
+                }
+            }
+
+            // Shared instances and level-of-detail views leave no host copy, so
+            // sample the energy now and then
+            if (frameBalls.empty() && frameIndex % SHARED_ENERGY_INTERVAL == 0) {
+                readBalls(frameBalls);
+            }
+            metrics.kineticEnergy = frameBalls.empty() ? -1.0 : 0.0;
+            for (const Ball& ball : frameBalls) {
+                float speedSquared = ball.velocity.x * ball.velocity.x + ball.velocity.y * ball.velocity.y;
+                metrics.kineticEnergy += 0.5 * ball.radius * ball.radius * speedSquared;
+            }
+            metrics.kernels = std::move(kernelIntervals);
+            recordFrameMetrics(std::move(metrics));
+        }
+        if (snapshot) {
+            snapshots.publish();
+        }
+
         // Handle window system events
-        glfwPollEvents();
+        if (run.windowed && !run.renderThread) {
+            TraceSpan span("poll events");
+            glfwPollEvents();
+        }
     }
-    
+    simulationFinished = true;
+}
+
+// Render thread: draws the latest snapshot at the display's pace and handles
+// window events until the window closes or the simulation finishes
+void renderLoop() {
+    while (!simulationFinished) {
+        {
+            TraceSpan span("poll events");
+            glfwPollEvents();
+        }
+        if (glfwWindowShouldClose(window)) {
+            windowClosed = true;
+            break;
+        }
+
+        // Without a new snapshot the last one is drawn again, since a swap
+        // leaves the back buffer undefined
+        snapshots.acquire();
+        TraceSpan span("render");
+        drawFrame(snapshots.front());
+        framesDrawn++;
+    }
+}
+
+// Main simulation loop and program entry point
+int main(int argc, char** argv) {
+    // Under mpirun every rank runs main; rank 0 alone owns the window, the
+    // initial state and all output
+    initDistributed(&argc, &argv);
+    const bool root = distributedRank() == 0;
+    const bool distributed = distributedSize() > 1;
+
+    parseCommandLine(argc, argv);
+    if (distributed && (!config.replayPath.empty() || config.eventDriven || config.devices > 1)) {
+        if (root) {
+            std::cerr << "Running under MPI cannot be combined with --replay, --event-driven or --devices"
+                      << std::endl;
+        }
+        finalizeDistributed();
+        exit(1);
+    }
+    if (config.seed != 0) {
+        rng.seed(config.seed);
+    }
+    if (!config.replayPath.empty()) {
+        runReplay();
+        return 0;
+    }
+
+    // Tracing covers setup too; only rank 0 records a timeline
+    if (root && !config.tracePath.empty()) {
+        startTrace(config.tracePath);
+    }
+
+    // A restored checkpoint sets the ball count, so load it before sizing buffers
+    std::vector<Ball> restoredBalls;
+    double simulationTime = 0.0;
+    if (root) {
+        if (!config.restorePath.empty()) {
+            loadCheckpoint(config.restorePath, restoredBalls, simulationTime, rng);
+        } else {
+            applyPackingFraction();
+        }
+    }
+    shareDistributedConfig();
+
+    // Initialize systems in required order; other ranks only hold their slab,
+    // in pipelines of their own, so their main pipeline stays minimal
+    // The window comes first so OpenCL can share its GL context
+    const bool windowed = root && !config.headless;
+    const bool renderThread = windowed && config.renderThread && !distributed;
+    if (windowed) {
+        TraceSpan span("initGraphics");
+        initGraphics();
+    } else if (root) {
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+    }
+    {
+        TraceSpan span("initOpenCL");
+        initOpenCL(root ? config.numBalls : 1,
+                   windowed && !renderThread ? glContextProperties() : std::vector<cl_context_properties>());
+    }
+    if (root) {
+        TraceSpan span("setup");
+        if (windowed && !renderThread) {
+            shareBallInstances(config.numBalls);
+        }
+        if (restoredBalls.empty()) {
+            initBalls();
+        } else {
+            cl_int error = clEnqueueWriteBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                               sizeof(Ball) * config.numBalls, restoredBalls.data(),
+                                               0, nullptr, nullptr);
+            checkError(error, "writing restored ball data");
+        }
+        if (!config.checkpointPath.empty()) {
+            startCheckpointWriter();
+        }
+    }
+
+    // Event-driven mode takes over from the uploaded initial state
+    if (config.eventDriven) {
+        std::vector<Ball> balls(config.numBalls);
+        cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                          sizeof(Ball) * config.numBalls, balls.data(),
+                                          0, nullptr, nullptr);
+        checkError(error, "reading initial ball data");
+        initEventSimulation(balls);
+    }
+
+    // Decomposed runs likewise take over the initial state, split into strips
+    if (config.devices > 1) {
+        std::vector<Ball> balls(config.numBalls);
+        cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                          sizeof(Ball) * config.numBalls, balls.data(),
+                                          0, nullptr, nullptr);
+        checkError(error, "reading initial ball data");
+        initDomainDecomposition(balls);
+    }
+
+    // Distributed runs scatter rank 0's initial state across the ranks' slabs
+    if (distributed) {
+        std::vector<Ball> balls;
+        if (root) {
+            balls.resize(config.numBalls);
+            cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                              sizeof(Ball) * config.numBalls, balls.data(),
+                                              0, nullptr, nullptr);
+            checkError(error, "reading initial ball data");
+        }
+        initDistributedSimulation(balls);
+    }
+
+    // Trajectory recording starts with the initial state as frame 0
+    if (root && !config.trajectoryPath.empty()) {
+        startTrajectoryRecorder(config.trajectoryPath, config.trajectoryInterval, config.trajectoryPrecision);
+        recordTrajectoryFrame(0, simulationTime);
+    }
+
+    // Frames are dumped from snapshots of ballBuffer, like the trajectory,
+    // starting with the initial state
+    if (root && !config.dumpPath.empty()) {
+        startFrameDump(config.dumpPath, config.dumpFormat, config.dumpThreads);
+        dumpFrame(0);
+    }
+
+    // Metrics are fed from the frame loop and published by their own thread
+    if (root && (!config.metricsPath.empty() || config.metricsPort > 0)) {
+        startMetrics(config.metricsPath, config.metricsPort);
+    }
+
+    // With a render thread this thread draws and handles window events, so
+    // neither vsync nor the event loop ever holds up a step; it starts on the
+    // initial state
+    LoopSettings run{root, distributed, windowed, renderThread};
+    if (renderThread) {
+        readFrame(snapshots.back());
+        snapshots.publish();
+        std::thread simulation(simulationLoop, std::cref(run), std::ref(simulationTime));
+        renderLoop();
+        simulation.join();
+    } else {
+        simulationLoop(run, simulationTime);
+    }
+
+    // Final checkpoint, waiting for any write still in progress
+    if (root && !config.checkpointPath.empty()) {
+        requestCheckpoint(config.checkpointPath, simulationTime, rng, true);
+        stopCheckpointWriter();
+    }
+    stopTrajectoryRecorder();
+    stopFrameDump();
+    if (config.devices > 1) {
+        cleanupDomainDecomposition();
+    }
+    finalizeDistributed();
+    stopMetrics();
+    stopTrace();
+
     // Release resources
     cleanup();
     return 0;
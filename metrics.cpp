@@ -0,0 +1,300 @@
+#include "metrics.h"
+#include "sim_config.h"
+#include "trace.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+// Kernel durations kept per kernel for the quantiles
+const size_t KERNEL_WINDOW = 1024;
+
+// Milliseconds between metric updates and file rewrites
+const int PUBLISH_INTERVAL_MS = 1000;
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;  // A scraper hanging up must not raise SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// Frames recorded since the metrics thread last looked; guarded by pendingMutex
+std::mutex pendingMutex;
+std::vector<FrameMetrics> pendingFrames;
+
+std::thread metricsThread;
+std::mutex stopMutex;
+std::condition_variable stopWake;
+bool metricsRunning = false;
+bool metricsStopping = false;
+std::string metricsPath;
+int listenSocket = -1;
+
+// Recent durations of one kernel, in seconds, plus running totals
+struct KernelSummary {
+    std::vector<double> window;  // Ring of the last KERNEL_WINDOW durations
+    size_t next = 0;
+    double sum = 0.0;
+    long long count = 0;
+};
+
+// State owned by the metrics thread
+long long stepsTotal = 0;
+long long stepsAtLastPublish = 0;
+double stepRate = 0.0;
+FrameMetrics latest{0.0, -1, -1, -1.0, 0, {}};
+std::map<std::string, KernelSummary> kernelSummaries;
+std::string exposition;  // Text served to scrapers
+
+// Value at quantile q of the unsorted samples
+double quantile(std::vector<double> samples, double q) {
+    size_t k = std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+// Folds the frames recorded since the last call into the totals
+void absorbPendingFrames() {
+    std::vector<FrameMetrics> frames;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        frames.swap(pendingFrames);
+    }
+    for (FrameMetrics& frame : frames) {
+        stepsTotal++;
+        for (const KernelInterval& interval : frame.kernels) {
+            KernelSummary& summary = kernelSummaries[interval.name];
+            double seconds = (interval.end - interval.start) * 1.0e-9;
+            if (summary.window.size() < KERNEL_WINDOW) {
+                summary.window.push_back(seconds);
+            } else {
+                summary.window[summary.next] = seconds;
+            }
+            summary.next = (summary.next + 1) % KERNEL_WINDOW;
+            summary.sum += seconds;
+            summary.count++;
+        }
+    }
+    if (!frames.empty()) {
+        // The energy is only sampled on some frames; keep the last sample
+        double kineticEnergy = latest.kineticEnergy;
+        for (const FrameMetrics& frame : frames) {
+            if (frame.kineticEnergy >= 0.0) {
+                kineticEnergy = frame.kineticEnergy;
+            }
+        }
+        latest = std::move(frames.back());
+        latest.kineticEnergy = kineticEnergy;
+    }
+}
+
+// Writes one metric's HELP and TYPE lines
+void describe(std::ostringstream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+// Renders every metric in the Prometheus text format
+std::string renderExposition() {
+    std::ostringstream out;
+    describe(out, "ballsim_steps_total", "counter", "Simulation steps completed.");
+    out << "ballsim_steps_total " << stepsTotal << '\n';
+    describe(out, "ballsim_step_rate", "gauge", "Steps per second over the last publish interval.");
+    out << "ballsim_step_rate " << stepRate << '\n';
+    describe(out, "ballsim_simulation_time_seconds", "gauge", "Simulated time.");
+    out << "ballsim_simulation_time_seconds " << latest.simulationTime << '\n';
+    describe(out, "ballsim_balls", "gauge", "Balls in the world.");
+    out << "ballsim_balls " << config.numBalls << '\n';
+    if (latest.activeBalls >= 0) {
+        describe(out, "ballsim_active_balls", "gauge", "Balls integrated in the last step.");
+        out << "ballsim_active_balls " << latest.activeBalls << '\n';
+    }
+    if (latest.contacts >= 0) {
+        describe(out, "ballsim_contacts", "gauge", "Overlapping ball pairs in the last step's contact list.");
+        out << "ballsim_contacts " << latest.contacts << '\n';
+    }
+    if (latest.kineticEnergy >= 0.0) {
+        describe(out, "ballsim_kinetic_energy", "gauge", "Total kinetic energy, with mass taken as radius squared.");
+        out << "ballsim_kinetic_energy " << latest.kineticEnergy << '\n';
+    }
+    describe(out, "ballsim_queue_depth", "gauge", "Kernel launches enqueued ahead of the last frame's clFinish.");
+    out << "ballsim_queue_depth " << latest.queueDepth << '\n';
+
+    if (!kernelSummaries.empty()) {
+        describe(out, "ballsim_kernel_duration_seconds", "summary",
+                 "Device execution time of each kernel launch.");
+        for (const auto& [name, summary] : kernelSummaries) {
+            std::string label = "kernel=\"" + name + "\"";
+            out << "ballsim_kernel_duration_seconds{" << label << ",quantile=\"0.5\"} "
+                << quantile(summary.window, 0.5) << '\n';
+            out << "ballsim_kernel_duration_seconds{" << label << ",quantile=\"0.99\"} "
+                << quantile(summary.window, 0.99) << '\n';
+            out << "ballsim_kernel_duration_seconds_sum{" << label << "} " << summary.sum << '\n';
+            out << "ballsim_kernel_duration_seconds_count{" << label << "} " << summary.count << '\n';
+        }
+    }
+    return out.str();
+}
+
+// Writes to a temporary file and renames it, so a collector never reads a
+// half-written file
+void writeMetricsFile() {
+    TraceSpan span("write metrics");
+    std::string temporaryPath = metricsPath + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::trunc);
+        out << exposition;
+        if (!out) {
+            std::cerr << "Failed to write metrics file: " << temporaryPath << std::endl;
+            return;
+        }
+    }
+    if (std::rename(temporaryPath.c_str(), metricsPath.c_str()) != 0) {
+        std::cerr << "Failed to replace metrics file: " << metricsPath << std::endl;
+    }
+}
+
+// Sends the whole buffer, giving up if the client goes away
+void sendAll(int client, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(client, data.data() + sent, data.size() - sent, SEND_FLAGS);
+        if (written <= 0) return;
+        sent += static_cast<size_t>(written);
+    }
+}
+
+// Answers one scrape; only the request line is looked at
+void serveScrape(int client) {
+    pollfd readable{client, POLLIN, 0};
+    char request[1024];
+    ssize_t received = 0;
+    if (poll(&readable, 1, 200) > 0) {
+        received = recv(client, request, sizeof(request) - 1, 0);
+    }
+    std::string requestLine(request, std::max<ssize_t>(received, 0));
+    requestLine = requestLine.substr(0, requestLine.find('\r'));
+
+    std::string status, body;
+    if (requestLine.rfind("GET /metrics ", 0) == 0 || requestLine.rfind("GET / ", 0) == 0) {
+        status = "200 OK";
+        body = exposition;
+    } else {
+        status = "404 Not Found";
+        body = "Metrics are served at /metrics\n";
+    }
+    sendAll(client, "HTTP/1.0 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                    std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+    close(client);
+}
+
+// Binds the scrape port on the loopback interface; exits on failure
+void openListenSocket(int port) {
+    listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_NOSIGPIPE
+    setsockopt(listenSocket, SOL_SOCKET, SO_NOSIGPIPE, &reuse, sizeof(reuse));
+#endif
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listenSocket < 0 || bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenSocket, 8) != 0) {
+        std::cerr << "Failed to listen for metrics scrapes on port " << port << std::endl;
+        exit(1);
+    }
+}
+
+// Publishes once a second and serves scrapes in between
+void metricsLoop() {
+    nameTraceThread("Metrics");
+    auto lastPublish = std::chrono::steady_clock::now();
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastPublish).count();
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(stopMutex);
+            stopping = metricsStopping;
+        }
+        if (elapsed * 1000.0 >= PUBLISH_INTERVAL_MS || stopping) {
+            absorbPendingFrames();
+            stepRate = elapsed > 0.0 ? (stepsTotal - stepsAtLastPublish) / elapsed : 0.0;
+            stepsAtLastPublish = stepsTotal;
+            lastPublish = now;
+            exposition = renderExposition();
+            if (!metricsPath.empty()) {
+                writeMetricsFile();
+            }
+        }
+        if (stopping) return;
+
+        int timeout = std::max(1, PUBLISH_INTERVAL_MS - static_cast<int>(elapsed * 1000.0));
+        if (listenSocket >= 0) {
+            pollfd incoming{listenSocket, POLLIN, 0};
+            if (poll(&incoming, 1, std::min(timeout, 100)) > 0) {
+                int client = accept(listenSocket, nullptr, nullptr);
+                if (client >= 0) {
+                    serveScrape(client);
+                }
+            }
+        } else {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            stopWake.wait_for(lock, std::chrono::milliseconds(timeout), [] { return metricsStopping; });
+        }
+    }
+}
+
+}  // namespace
+
+void startMetrics(const std::string& path, int port) {
+    metricsPath = path;
+    if (port > 0) {
+        openListenSocket(port);
+        std::cout << "Serving metrics at http://127.0.0.1:" << port << "/metrics" << std::endl;
+    }
+    metricsStopping = false;
+    metricsRunning = true;
+    exposition = renderExposition();
+    metricsThread = std::thread(metricsLoop);
+}
+
+bool metricsEnabled() {
+    return metricsRunning;
+}
+
+void recordFrameMetrics(FrameMetrics frame) {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    pendingFrames.push_back(std::move(frame));
+}
+
+void stopMetrics() {
+    if (!metricsRunning) return;
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        metricsStopping = true;
+    }
+    stopWake.notify_one();
+    metricsThread.join();
+    if (listenSocket >= 0) {
+        close(listenSocket);
+        listenSocket = -1;
+    }
+    metricsRunning = false;
+}
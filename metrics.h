@@ -0,0 +1,38 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include "simulation.h"
+
+// Live metrics in the Prometheus text exposition format
+// The frame loop hands each frame's figures to recordFrameMetrics, which only
+// appends them under a short lock. A background thread folds them into
+// counters, gauges and per-kernel duration summaries once a second, rewrites
+// the metrics file and answers HTTP scrapes on a local port, so neither
+// formatting nor I/O ever runs on the frame loop
+
+// Figures of one simulated frame
+struct FrameMetrics {
+    double simulationTime;
+    int activeBalls;       // Balls integrated this step, or -1 when unknown
+    int contacts;          // Overlapping pairs in the contact list, or -1
+    double kineticEnergy;  // Sum of r^2 |v|^2 / 2, mass taken as area like the solver,
+                           // or -1 when the frame was not read back
+    int queueDepth;        // Kernel launches enqueued ahead of the frame's clFinish
+    std::vector<KernelInterval> kernels;
+};
+
+// Starts the metrics thread; path is rewritten every second when not empty,
+// and port > 0 serves GET /metrics on 127.0.0.1
+void startMetrics(const std::string& path, int port);
+
+bool metricsEnabled();
+
+// Queues a frame for the metrics thread; never waits for I/O
+void recordFrameMetrics(FrameMetrics frame);
+
+// Publishes the final values and stops the thread
+void stopMetrics();
+
+#endif // METRICS_H
@@ -0,0 +1,127 @@
+#include "placement.h"
+#include "sim_config.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Available ball sizes
+const float BALL_RADII[BALL_SIZE_COUNT] = BALL_SIZES;
+
+// Balls generated per RNG block; each block has its own generator seeded
+// from the caller's, so threads can take blocks in any order
+const int PLACEMENT_BLOCK = 16384;
+
+// Mean ball area for the radius distribution
+float meanBallArea() {
+    float sum = 0.0f;
+    for (float radius : BALL_RADII) sum += radius * radius;
+    return static_cast<float>(M_PI) * sum / BALL_SIZE_COUNT;
+}
+
+// Picks numBalls distinct cells out of cellCount
+std::vector<uint32_t> chooseCells(uint64_t cellCount, int numBalls, std::mt19937& rng) {
+    std::vector<uint32_t> cells;
+    cells.reserve(numBalls);
+
+    if (cellCount >= 2 * static_cast<uint64_t>(numBalls)) {
+        // Sparse: rejection sampling needs fewer than two draws per ball and
+        // only a bit per cell
+        std::vector<bool> taken(cellCount);
+        std::uniform_int_distribution<uint64_t> cellDist(0, cellCount - 1);
+        while (cells.size() < static_cast<size_t>(numBalls)) {
+            uint64_t cell = cellDist(rng);
+            if (taken[cell]) continue;
+            taken[cell] = true;
+            cells.push_back(static_cast<uint32_t>(cell));
+        }
+    } else {
+        // Dense: partial Fisher-Yates shuffle of all cells
+        cells.resize(cellCount);
+        for (uint64_t i = 0; i < cellCount; i++) cells[i] = static_cast<uint32_t>(i);
+        for (int i = 0; i < numBalls; i++) {
+            std::uniform_int_distribution<uint64_t> pick(i, cellCount - 1);
+            std::swap(cells[i], cells[pick(rng)]);
+        }
+        cells.resize(numBalls);
+    }
+    return cells;
+}
+
+}  // namespace
+
+void applyPackingFraction() {
+    if (config.packingFraction <= 0.0f) return;
+
+    float area = config.numBalls * meanBallArea() / config.packingFraction;
+    float aspect = config.worldWidth / config.worldHeight;
+    int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(area * aspect) / PLACEMENT_CELL)));
+    int rows = std::max(1, static_cast<int>(std::ceil(area / (columns * PLACEMENT_CELL * PLACEMENT_CELL))));
+
+    // Rounding to whole cells can leave too few for small ball counts
+    while (static_cast<long long>(columns) * rows < config.numBalls) rows++;
+    config.worldWidth = columns * PLACEMENT_CELL;
+    config.worldHeight = rows * PLACEMENT_CELL;
+    std::cout << "World " << config.worldWidth << "x" << config.worldHeight << " for packing fraction "
+              << config.numBalls * meanBallArea() / (config.worldWidth * config.worldHeight) << std::endl;
+}
+
+void placementGrid(int& columns, int& rows) {
+    columns = static_cast<int>(config.worldWidth / PLACEMENT_CELL);
+    rows = static_cast<int>(config.worldHeight / PLACEMENT_CELL);
+    uint64_t cellCount = static_cast<uint64_t>(columns) * rows;
+    if (cellCount < static_cast<uint64_t>(config.numBalls) || cellCount > UINT32_MAX) {
+        std::cerr << "Cannot place " << config.numBalls << " balls without overlap in a "
+                  << config.worldWidth << "x" << config.worldHeight
+                  << " world; use fewer balls, a larger --world or --packing" << std::endl;
+        exit(1);
+    }
+}
+
+void placeBalls(std::vector<Ball>& balls, std::mt19937& rng) {
+    int columns, rows;
+    placementGrid(columns, rows);
+    uint64_t cellCount = static_cast<uint64_t>(columns) * rows;
+
+    balls.assign(config.numBalls, Ball());
+    std::vector<uint32_t> cells = chooseCells(cellCount, config.numBalls, rng);
+
+    // Block seeds are drawn up front so the result is independent of threading
+    int blockCount = (config.numBalls + PLACEMENT_BLOCK - 1) / PLACEMENT_BLOCK;
+    std::vector<uint32_t> seeds(blockCount);
+    for (uint32_t& seed : seeds) seed = rng();
+
+    std::atomic<int> nextBlock{0};
+    auto worker = [&]() {
+        std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+        std::uniform_real_distribution<float> velDist(-MAX_INITIAL_VELOCITY, MAX_INITIAL_VELOCITY);
+        for (int block = nextBlock++; block < blockCount; block = nextBlock++) {
+            std::mt19937 blockRng(seeds[block]);
+            int end = std::min(config.numBalls, (block + 1) * PLACEMENT_BLOCK);
+            for (int i = block * PLACEMENT_BLOCK; i < end; i++) {
+                Ball& ball = balls[i];
+                ball.radius = BALL_RADII[blockRng() % BALL_SIZE_COUNT];
+
+                // Jitter the centre over the part of the cell the ball fits in
+                float slack = PLACEMENT_CELL - 2.0f * ball.radius;
+                float cellX = static_cast<float>(cells[i] % columns) * PLACEMENT_CELL;
+                float cellY = static_cast<float>(cells[i] / columns) * PLACEMENT_CELL;
+                ball.position.x = cellX + ball.radius + unitDist(blockRng) * slack;
+                ball.position.y = cellY + ball.radius + unitDist(blockRng) * slack;
+
+                ball.velocity.x = velDist(blockRng);
+                ball.velocity.y = velDist(blockRng);
+            }
+        }
+    };
+
+    int threadCount = std::min<int>(blockCount, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++) threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads) thread.join();
+}
@@ -0,0 +1,31 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <random>
+#include <vector>
+#include "simulation.h"
+
+// Non-overlapping initial placement
+// The world is divided into square cells one maximum diameter wide. Each ball
+// takes a distinct random cell and is jittered inside it, so no two balls can
+// overlap whatever their radii. On the host, radii, jitter and velocities are
+// generated in parallel, in fixed-size blocks seeded from rng, so the result
+// depends only on rng and not on the number of threads. generateBallsOnDevice
+// (simulation.h) builds the same layout on the device instead
+
+// Placement cells: one maximum diameter wide, so a ball jittered inside its
+// own cell never reaches a neighbour's
+const float PLACEMENT_CELL = 2.0f * MAX_RADIUS;
+
+// Sets the world size from config.packingFraction, keeping the configured
+// aspect ratio and leaving at least one placement cell per ball
+void applyPackingFraction();
+
+// Placement grid size for the configured world
+// Exits if the world has fewer placement cells than balls
+void placementGrid(int& columns, int& rows);
+
+// Fills balls with config.numBalls random, non-overlapping balls on the host
+void placeBalls(std::vector<Ball>& balls, std::mt19937& rng);
+
+#endif // PLACEMENT_H
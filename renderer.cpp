@@ -0,0 +1,445 @@
+// Instanced drawing needs GL 1.5-2.1 entry points and the ARB instancing
+// extensions, which the system GL headers only declare on request
+#define GL_GLEXT_PROTOTYPES
+#define GLFW_INCLUDE_GLEXT
+#include <GLFW/glfw3.h>
+#include "renderer.h"
+#include "simulation.h"
+#include "sim_config.h"
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <OpenCL/cl_gl_ext.h>
+#else
+#include <GL/glx.h>
+#include <CL/cl_gl.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace {
+
+// Generic attribute slots of ball.vert
+const GLuint CORNER_ATTRIBUTE = 0;
+const GLuint CENTRE_ATTRIBUTE = 1;
+const GLuint RADIUS_ATTRIBUTE = 2;
+const GLuint COLOUR_ATTRIBUTE = 3;
+
+// ball_sprite.vert has no corner; compatibility contexts draw nothing unless
+// attribute 0 is enabled, so the sprite centre takes slot 0 instead
+const GLuint SPRITE_CENTRE_ATTRIBUTE = 0;
+
+// Colour offset for instance data without a colour index; colours then come
+// from colourBuffer by ball index
+const GLint INDEX_COLOURS = -1;
+
+// Stride and offsets of (x, y, radius, colour index) instances
+const GLsizei PACKED_STRIDE = 4 * sizeof(float);
+const size_t PACKED_RADIUS = 2 * sizeof(float);
+const GLint PACKED_COLOUR = 3 * sizeof(float);
+
+// Fill and outline alpha
+const float FILL_ALPHA = 0.9f;
+const float OUTLINE_ALPHA = 1.0f;
+
+// Circle mesh: the centre, then CIRCLE_SEGMENTS + 1 rim vertices with the
+// first repeated to close the fan; the outline loop uses the rim alone
+float circle[2 * (CIRCLE_SEGMENTS + 2)];
+
+bool instanced = false;
+bool sprites = false;  // One shaded point per ball instead of the circle mesh
+bool shared = false;   // sharedBuffer is filled by OpenCL
+GLuint circleBuffer = 0, instanceBuffer = 0, sharedBuffer = 0;
+GLuint program = 0;
+GLint alphaUniform = -1;
+
+// Point sprite program
+GLuint spriteProgram = 0;
+float pixelsPerUnit[2] = {1.0f, 1.0f};  // Framebuffer pixels per world unit along x and y
+
+// Colour index of every ball, grown on demand
+GLuint colourBuffer = 0;
+size_t colourCapacity = 0;
+
+// Level-of-detail heat texture of sub-pixel balls and its pixels
+GLuint heatTexture = 0;
+int heatWidth = 0, heatHeight = 0;
+std::vector<unsigned char> heatPixels;
+
+// Ball colors, cycling by ball index, for the immediate-mode fallback
+const float colors[3][3] = {
+    {1.0f, 0.0f, 0.0f},  // Red
+    {0.0f, 1.0f, 0.0f},  // Green
+    {0.0f, 0.0f, 1.0f}   // Blue
+};
+
+// Compiles one shader stage, exiting with the compile log on failure
+GLuint compileShader(GLenum stage, const std::string& filename) {
+    std::string source = readFile(filename);
+    const char* src = source.c_str();
+    GLuint shader = glCreateShader(stage);
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[2048];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << filename << " compile error: " << log << std::endl;
+        exit(1);
+    }
+    return shader;
+}
+
+// Links a ball shader pair with the attribute slots above, the centre at
+// centreAttribute
+GLuint buildProgram(const char* vertexFile, const char* fragmentFile, GLuint centreAttribute) {
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexFile);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentFile);
+    GLuint linkedProgram = glCreateProgram();
+    glAttachShader(linkedProgram, vertexShader);
+    glAttachShader(linkedProgram, fragmentShader);
+    if (centreAttribute != CORNER_ATTRIBUTE) {
+        glBindAttribLocation(linkedProgram, CORNER_ATTRIBUTE, "corner");
+    }
+    glBindAttribLocation(linkedProgram, centreAttribute, "centre");
+    glBindAttribLocation(linkedProgram, RADIUS_ATTRIBUTE, "radius");
+    glBindAttribLocation(linkedProgram, COLOUR_ATTRIBUTE, "colourIndex");
+    glLinkProgram(linkedProgram);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(linkedProgram, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[2048];
+        glGetProgramInfoLog(linkedProgram, sizeof(log), nullptr, log);
+        std::cerr << vertexFile << " link error: " << log << std::endl;
+        exit(1);
+    }
+    return linkedProgram;
+}
+
+// Whether the driver draws points large enough for the biggest ball
+// The projection stretches the world to the viewport on each axis, so both
+// scales are kept and sprites shade the same ellipses the mesh draws
+bool spritesFit() {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    pixelsPerUnit[0] = viewport[2] / config.worldWidth;
+    pixelsPerUnit[1] = viewport[3] / config.worldHeight;
+
+    GLfloat sizeRange[2];
+    glGetFloatv(GL_ALIASED_POINT_SIZE_RANGE, sizeRange);
+    float largest = 2.0f * (MAX_RADIUS * std::max(pixelsPerUnit[0], pixelsPerUnit[1]) + 2.0f);
+    if (largest <= sizeRange[1]) return true;
+    std::cout << "Point sprites are limited to " << sizeRange[1] << " pixels but balls need " << largest
+              << ", drawing the circle mesh" << std::endl;
+    return false;
+}
+
+// Colour index (ball index modulo 3) of the first count balls
+void reserveColourIndices(size_t count) {
+    if (count <= colourCapacity) return;
+    colourCapacity = count + count / 2;
+    std::vector<float> indices(colourCapacity);
+    for (size_t i = 0; i < colourCapacity; i++) {
+        indices[i] = static_cast<float>(i % 3);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, colourBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * colourCapacity, indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Points the ball attributes at buffer, with the given stride and offsets,
+// or at colourBuffer for colourOffset INDEX_COLOURS
+void bindBallAttributes(GLuint centreAttribute, GLuint buffer, GLsizei count, GLsizei stride, size_t centreOffset,
+                        size_t radiusOffset, GLint colourOffset) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(centreAttribute, 2, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(centreOffset));
+    glVertexAttribPointer(RADIUS_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(radiusOffset));
+    if (colourOffset == INDEX_COLOURS) {
+        reserveColourIndices(count);
+        glBindBuffer(GL_ARRAY_BUFFER, colourBuffer);
+        glVertexAttribPointer(COLOUR_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+    } else {
+        glVertexAttribPointer(COLOUR_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void*>(static_cast<size_t>(colourOffset)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// One point per ball
+void drawSprites(GLuint buffer, GLsizei count, GLsizei stride, size_t centreOffset, size_t radiusOffset,
+                 GLint colourOffset) {
+    bindBallAttributes(SPRITE_CENTRE_ATTRIBUTE, buffer, count, stride, centreOffset, radiusOffset, colourOffset);
+    glUseProgram(spriteProgram);
+    glUniform2f(glGetUniformLocation(spriteProgram, "pixelsPerUnit"), pixelsPerUnit[0], pixelsPerUnit[1]);
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    glEnable(GL_POINT_SPRITE);
+    glEnableVertexAttribArray(SPRITE_CENTRE_ATTRIBUTE);
+    glEnableVertexAttribArray(RADIUS_ATTRIBUTE);
+    glEnableVertexAttribArray(COLOUR_ATTRIBUTE);
+
+    glDrawArrays(GL_POINTS, 0, count);
+
+    glDisableVertexAttribArray(SPRITE_CENTRE_ATTRIBUTE);
+    glDisableVertexAttribArray(RADIUS_ATTRIBUTE);
+    glDisableVertexAttribArray(COLOUR_ATTRIBUTE);
+    glDisable(GL_POINT_SPRITE);
+    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    glUseProgram(0);
+}
+
+// One fill and one outline draw of the circle mesh over count balls, reading
+// each ball's position, radius and colour index from buffer at the given
+// stride and offsets; sprites, when enabled, replace the mesh
+void drawInstanced(GLuint buffer, GLsizei count, GLsizei stride, size_t centreOffset, size_t radiusOffset,
+                   GLint colourOffset) {
+    if (sprites) {
+        drawSprites(buffer, count, stride, centreOffset, radiusOffset, colourOffset);
+        return;
+    }
+
+    bindBallAttributes(CENTRE_ATTRIBUTE, buffer, count, stride, centreOffset, radiusOffset, colourOffset);
+    glBindBuffer(GL_ARRAY_BUFFER, circleBuffer);
+    glVertexAttribPointer(CORNER_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(program);
+    glEnableVertexAttribArray(CORNER_ATTRIBUTE);
+    glEnableVertexAttribArray(CENTRE_ATTRIBUTE);
+    glEnableVertexAttribArray(RADIUS_ATTRIBUTE);
+    glEnableVertexAttribArray(COLOUR_ATTRIBUTE);
+    glVertexAttribDivisorARB(CENTRE_ATTRIBUTE, 1);
+    glVertexAttribDivisorARB(RADIUS_ATTRIBUTE, 1);
+    glVertexAttribDivisorARB(COLOUR_ATTRIBUTE, 1);
+
+    glUniform1f(alphaUniform, FILL_ALPHA);
+    glDrawArraysInstancedARB(GL_TRIANGLE_FAN, 0, CIRCLE_SEGMENTS + 2, count);
+    glUniform1f(alphaUniform, OUTLINE_ALPHA);
+    glLineWidth(2.0f);
+    glDrawArraysInstancedARB(GL_LINE_LOOP, 1, CIRCLE_SEGMENTS, count);
+
+    glVertexAttribDivisorARB(CENTRE_ATTRIBUTE, 0);
+    glVertexAttribDivisorARB(RADIUS_ATTRIBUTE, 0);
+    glVertexAttribDivisorARB(COLOUR_ATTRIBUTE, 0);
+    glDisableVertexAttribArray(CORNER_ATTRIBUTE);
+    glDisableVertexAttribArray(CENTRE_ATTRIBUTE);
+    glDisableVertexAttribArray(RADIUS_ATTRIBUTE);
+    glDisableVertexAttribArray(COLOUR_ATTRIBUTE);
+    glUseProgram(0);
+}
+
+// Per-ball immediate mode over the precomputed circle
+void drawImmediate(const std::vector<Ball>& balls) {
+    for (size_t i = 0; i < balls.size(); i++) {
+        const Ball& ball = balls[i];
+        const float* color = colors[i % 3];
+
+        // Draw filled circle
+        glColor4f(color[0], color[1], color[2], FILL_ALPHA);
+        glBegin(GL_TRIANGLE_FAN);
+        for (int j = 0; j < CIRCLE_SEGMENTS + 2; j++) {
+            glVertex2f(ball.position.x + circle[2 * j] * ball.radius,
+                       ball.position.y + circle[2 * j + 1] * ball.radius);
+        }
+        glEnd();
+
+        // Draw circle outline
+        glColor4f(color[0], color[1], color[2], OUTLINE_ALPHA);
+        glLineWidth(2.0f);
+        glBegin(GL_LINE_LOOP);
+        for (int j = 1; j <= CIRCLE_SEGMENTS; j++) {
+            glVertex2f(ball.position.x + circle[2 * j] * ball.radius,
+                       ball.position.y + circle[2 * j + 1] * ball.radius);
+        }
+        glEnd();
+    }
+}
+
+}  // namespace
+
+void initBallRenderer() {
+    circle[0] = 0.0f;
+    circle[1] = 0.0f;
+    for (int j = 0; j <= CIRCLE_SEGMENTS; j++) {
+        float angle = 2.0f * M_PI * j / CIRCLE_SEGMENTS;
+        circle[2 * (j + 1)] = std::cos(angle);
+        circle[2 * (j + 1) + 1] = std::sin(angle);
+    }
+
+    // Sprites need only GL 2.0 shaders, so they also replace the immediate-mode
+    // fallback; level-of-detail frames draw their discs as sprites when they fit
+    sprites = config.renderMode != RenderMode::Mesh && spritesFit();
+    instanced = glfwExtensionSupported("GL_ARB_instanced_arrays") &&
+                glfwExtensionSupported("GL_ARB_draw_instanced");
+    if (!instanced && !sprites) {
+        std::cout << "Instanced drawing unavailable, drawing balls in immediate mode" << std::endl;
+        return;
+    }
+
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &colourBuffer);
+    if (sprites) {
+        spriteProgram = buildProgram("ball_sprite.vert", "ball_sprite.frag", SPRITE_CENTRE_ATTRIBUTE);
+        return;
+    }
+    glGenBuffers(1, &circleBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, circleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(circle), circle, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    program = buildProgram("ball.vert", "ball.frag", CENTRE_ATTRIBUTE);
+    alphaUniform = glGetUniformLocation(program, "alpha");
+}
+
+void drawBallBatch(const std::vector<Ball>& balls) {
+    // Enable anti-aliasing
+    glEnable(GL_LINE_SMOOTH);
+    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+
+    if (balls.empty()) return;
+    if (!instanced && !sprites) {
+        drawImmediate(balls);
+        return;
+    }
+
+    // Orphan last frame's storage so the upload never waits for its draws
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Ball) * balls.size(), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Ball) * balls.size(), balls.data());
+
+    // Balls are read straight out of the Ball array, velocity and padding skipped
+    drawInstanced(instanceBuffer, static_cast<GLsizei>(balls.size()), sizeof(Ball),
+                  offsetof(Ball, position), offsetof(Ball, radius), INDEX_COLOURS);
+}
+
+std::vector<cl_context_properties> glContextProperties() {
+#ifdef __APPLE__
+    CGLShareGroupObj shareGroup = CGLGetShareGroup(CGLGetCurrentContext());
+    if (!shareGroup) return {};
+    return {CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE, (cl_context_properties)shareGroup};
+#else
+    // GLFW windows on Wayland have EGL contexts, which are not shared
+    GLXContext glContext = glXGetCurrentContext();
+    if (!glContext) return {};
+    return {CL_GL_CONTEXT_KHR, (cl_context_properties)glContext,
+            CL_GLX_DISPLAY_KHR, (cl_context_properties)glXGetCurrentDisplay()};
+#endif
+}
+
+void shareBallInstances(int numBalls) {
+    // Level-of-detail frames use vertexBuffer for their disc list
+    if ((!instanced && !sprites) || !glSharingEnabled() || config.renderMode == RenderMode::Lod) return;
+    glGenBuffers(1, &sharedBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, sharedBuffer);
+    glBufferData(GL_ARRAY_BUFFER, PACKED_STRIDE * numBalls, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    shareVertexBuffer(sharedBuffer);
+    shared = true;
+    std::cout << "Drawing balls from an OpenCL/OpenGL shared buffer" << std::endl;
+}
+
+bool ballInstancesShared() {
+    return shared;
+}
+
+void drawSharedBallBatch(int numBalls) {
+    glEnable(GL_LINE_SMOOTH);
+    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+    if (numBalls == 0) return;
+    drawInstanced(sharedBuffer, numBalls, PACKED_STRIDE, 0, PACKED_RADIUS, PACKED_COLOUR);
+}
+
+void drawLodFrame(const std::vector<cl_int>& density, int width, int height, const std::vector<cl_float4>& discs) {
+    // Log-scaled heat of each pixel's ball count against the busiest pixel,
+    // black through red and yellow to white; empty pixels stay transparent
+    int busiest = 1;
+    for (cl_int count : density) {
+        busiest = std::max(busiest, static_cast<int>(count));
+    }
+    float scale = 1.0f / std::log(1.0f + busiest);
+    heatPixels.resize(4 * density.size());
+    for (size_t i = 0; i < density.size(); i++) {
+        float heat = density[i] > 0 ? 0.25f + 0.75f * std::log(1.0f + density[i]) * scale : 0.0f;
+        heatPixels[4 * i] = static_cast<unsigned char>(255.0f * std::min(1.0f, 3.0f * heat));
+        heatPixels[4 * i + 1] = static_cast<unsigned char>(255.0f * std::clamp(3.0f * heat - 1.0f, 0.0f, 1.0f));
+        heatPixels[4 * i + 2] = static_cast<unsigned char>(255.0f * std::clamp(3.0f * heat - 2.0f, 0.0f, 1.0f));
+        heatPixels[4 * i + 3] = density[i] > 0 ? 255 : 0;
+    }
+
+    if (!heatTexture || heatWidth != width || heatHeight != height) {
+        if (!heatTexture) glGenTextures(1, &heatTexture);
+        heatWidth = width;
+        heatHeight = height;
+        glBindTexture(GL_TEXTURE_2D, heatTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, heatTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, heatPixels.data());
+
+    // Image row 0 is world y = 0, like the balls
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, 0.0f);
+    glVertex2f(config.worldWidth, 0.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(config.worldWidth, config.worldHeight);
+    glTexCoord2f(0.0f, 1.0f);
+    glVertex2f(0.0f, config.worldHeight);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glEnable(GL_LINE_SMOOTH);
+    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+    if (discs.empty()) return;
+    if (!instanced && !sprites) {
+        std::vector<Ball> balls(discs.size());
+        for (size_t i = 0; i < discs.size(); i++) {
+            balls[i].position = {discs[i].s[0], discs[i].s[1]};
+            balls[i].radius = discs[i].s[2];
+        }
+        drawImmediate(balls);
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cl_float4) * discs.size(), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(cl_float4) * discs.size(), discs.data());
+    drawInstanced(instanceBuffer, static_cast<GLsizei>(discs.size()), PACKED_STRIDE, 0, PACKED_RADIUS,
+                  PACKED_COLOUR);
+}
+
+void cleanupBallRenderer() {
+    if (heatTexture) {
+        glDeleteTextures(1, &heatTexture);
+        heatTexture = 0;
+        heatWidth = heatHeight = 0;
+    }
+    if (!instanced && !sprites) return;
+    if (sprites) {
+        glDeleteProgram(spriteProgram);
+        sprites = false;
+    } else {
+        glDeleteProgram(program);
+        glDeleteBuffers(1, &circleBuffer);
+    }
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &colourBuffer);
+    colourCapacity = 0;
+    if (shared) {
+        glDeleteBuffers(1, &sharedBuffer);
+        shared = false;
+    }
+    instanced = false;
+}
@@ -0,0 +1,52 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+#include "ball_def.h"
+#include "simulation.h"
+
+// Ball drawing
+// The unit circle is built once: a fan of CIRCLE_SEGMENTS triangles around its
+// centre, stored in a static vertex buffer. Each frame the Ball array is
+// streamed into an orphaned instance buffer as is, and two instanced draws
+// place the mesh on every ball: one for the fills and one for the outlines.
+// Without ARB_instanced_arrays and ARB_draw_instanced the same unit circle is
+// drawn per ball in immediate mode, still without any trigonometry per frame
+// When OpenCL shares the GL context, the instances instead live in a GL buffer
+// that OpenCL fills from ballBuffer (enqueueVertexUpdate), so the balls never
+// pass through host memory
+// With --render=lod, balls below a few pixels across are drawn as a heat map
+// of balls per pixel and only the larger ones as circles (drawLodFrame)
+
+const int CIRCLE_SEGMENTS = 32;
+
+// Builds the circle mesh, buffers and shader program; needs a current GL context
+void initBallRenderer();
+
+// Draws balls as filled, outlined circles in the current projection
+void drawBallBatch(const std::vector<Ball>& balls);
+
+// Context properties naming the current GL context (GLX, or the CGL share
+// group on macOS), for initOpenCL; empty when there is none to share
+std::vector<cl_context_properties> glContextProperties();
+
+// With OpenCL sharing the GL context, allocates the instance buffer for
+// numBalls balls as a GL buffer and hands it to OpenCL as vertexBuffer
+// Call after initOpenCL; does nothing without sharing or instancing
+void shareBallInstances(int numBalls);
+
+bool ballInstancesShared();
+
+// Draws numBalls balls from the shared instance buffer; the frame's vertex
+// update must have finished
+void drawSharedBallBatch(int numBalls);
+
+// Draws a level-of-detail frame from readLodView: density, a width x height
+// image of balls per pixel over the world, as a log-scaled heat map, then
+// discs as filled, outlined circles
+void drawLodFrame(const std::vector<cl_int>& density, int width, int height, const std::vector<cl_float4>& discs);
+
+// Releases the buffers, textures and shader program
+void cleanupBallRenderer();
+
+#endif // RENDERER_H
@@ -0,0 +1,231 @@
+#include "replay.h"
+#include "trajectory.h"
+#include "trajectory_codec.h"
+#include "sim_config.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char* mappedData = nullptr;
+size_t mappedSize = 0;
+TrajectoryHeader header;
+std::vector<TrajectoryIndexEntry> frames;
+TrajectoryCodec codec;
+
+std::vector<Ball> balls;            // Radii from the header, positions of the shown frame
+std::vector<float> positions;
+long long decodedFrame = -1;        // Index of the frame held by the codec
+double playbackTime = 0.0;
+double playbackSpeed = 1.0;
+bool paused = false;
+
+// Copies a possibly unaligned record out of the mapping
+template <typename T>
+T readRecord(uint64_t offset) {
+    T value;
+    std::memcpy(&value, mappedData + offset, sizeof(T));
+    return value;
+}
+
+// Whether a frame record at offset, with byteSize bytes of positions, ends by
+// limit and, in raw files, holds exactly one position per ball
+bool frameFits(uint64_t offset, uint64_t byteSize, uint64_t limit) {
+    if (offset > limit || limit - offset < sizeof(TrajectoryFrameHeader)) return false;
+    if (limit - offset - sizeof(TrajectoryFrameHeader) < byteSize) return false;
+    return header.encoding != TRAJECTORY_RAW || byteSize == 2 * sizeof(float) * uint64_t(header.numBalls);
+}
+
+// Rebuilds the frame index of a file whose run ended before the trailer
+// was written, or whose index is damaged, by walking the chunks
+// A frame torn by an interrupted write ends the chunk
+void scanChunks(uint64_t offset) {
+    while (offset + sizeof(TrajectoryChunkHeader) <= mappedSize) {
+        TrajectoryChunkHeader chunk = readRecord<TrajectoryChunkHeader>(offset);
+        if (chunk.magic != TRAJECTORY_CHUNK_MAGIC || chunk.byteSize > mappedSize - offset - sizeof(chunk)) break;
+        uint64_t end = offset + sizeof(chunk) + chunk.byteSize;
+
+        offset += sizeof(chunk);
+        for (uint32_t i = 0; i < chunk.frameCount && offset + sizeof(TrajectoryFrameHeader) <= end; i++) {
+            TrajectoryFrameHeader frame = readRecord<TrajectoryFrameHeader>(offset);
+            if (!frameFits(offset, frame.byteSize, end)) break;
+            frames.push_back(TrajectoryIndexEntry{frame.frame, frame.time, offset, frame.byteSize, frame.flags});
+            offset += sizeof(frame) + frame.byteSize;
+        }
+        offset = end;
+    }
+}
+
+// Decodes recorded frame k into the ball array
+void decodeFrame(long long k) {
+    if (k == decodedFrame) return;
+
+    if (header.encoding == TRAJECTORY_RAW) {
+        std::memcpy(positions.data(), mappedData + frames[k].offset + sizeof(TrajectoryFrameHeader),
+                    positions.size() * sizeof(float));
+    } else {
+        // Delta frames continue from the frame the codec holds, unless a
+        // keyframe at or before k lets decoding skip ahead
+        long long keyframe = k;
+        while (keyframe > 0 && !(frames[keyframe].flags & TRAJECTORY_KEYFRAME)) keyframe--;
+        bool continues = decodedFrame >= 0 && decodedFrame < k && keyframe <= decodedFrame;
+        long long start = continues ? decodedFrame + 1 : keyframe;
+        for (long long j = start; j <= k; j++) {
+            const char* data = mappedData + frames[j].offset + sizeof(TrajectoryFrameHeader);
+            bool isKeyframe = frames[j].flags & TRAJECTORY_KEYFRAME;
+            if (!decodeTrajectoryFrame(codec, data, frames[j].byteSize, isKeyframe, positions.data())) {
+                // The codec state is garbage; the next decode restarts from a keyframe
+                std::cerr << "Corrupt trajectory frame " << frames[j].frame << std::endl;
+                decodedFrame = -1;
+                return;
+            }
+        }
+    }
+    decodedFrame = k;
+
+    for (size_t i = 0; i < balls.size(); i++) {
+        balls[i].position.x = positions[2 * i];
+        balls[i].position.y = positions[2 * i + 1];
+    }
+}
+
+// Last recorded frame at or before the given time
+long long frameAt(double time) {
+    auto next = std::upper_bound(frames.begin(), frames.end(), time,
+                                 [](double t, const TrajectoryIndexEntry& entry) { return t < entry.time; });
+    return std::max<long long>(0, (next - frames.begin()) - 1);
+}
+
+}  // namespace
+
+void openReplay(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Failed to open trajectory file: " << path << std::endl;
+        exit(1);
+    }
+    mappedSize = info.st_size;
+    void* mapping = mappedSize > 0 ? mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map trajectory file: " << path << std::endl;
+        exit(1);
+    }
+    mappedData = static_cast<const char*>(mapping);
+
+    if (mappedSize < sizeof(TrajectoryHeader)) {
+        std::cerr << "Not a trajectory file: " << path << std::endl;
+        exit(1);
+    }
+    header = readRecord<TrajectoryHeader>(0);
+    if (std::memcmp(header.magic, "BALLTRAJ", sizeof(header.magic)) != 0) {
+        std::cerr << "Not a trajectory file: " << path << std::endl;
+        exit(1);
+    }
+    if (header.version != TRAJECTORY_VERSION) {
+        std::cerr << "Unsupported trajectory version " << header.version << " in " << path << std::endl;
+        exit(1);
+    }
+    uint64_t radiiOffset = sizeof(TrajectoryHeader);
+    uint64_t chunksOffset = radiiOffset + sizeof(float) * header.numBalls;
+    if (header.numBalls == 0 || chunksOffset > mappedSize) {
+        std::cerr << "Truncated trajectory file: " << path << std::endl;
+        exit(1);
+    }
+
+    // Use the stored index when the recording finished cleanly
+    TrajectoryTrailer trailer = {};
+    if (mappedSize >= chunksOffset + sizeof(trailer)) {
+        trailer = readRecord<TrajectoryTrailer>(mappedSize - sizeof(trailer));
+    }
+    uint64_t indexSpace = mappedSize - sizeof(trailer);
+    if (std::memcmp(trailer.magic, "TRAJIDX", 8) == 0 && trailer.indexOffset >= chunksOffset &&
+        trailer.indexOffset <= indexSpace &&
+        trailer.frameCount <= (indexSpace - trailer.indexOffset) / sizeof(TrajectoryIndexEntry)) {
+        frames.resize(trailer.frameCount);
+        std::memcpy(frames.data(), mappedData + trailer.indexOffset, frames.size() * sizeof(TrajectoryIndexEntry));
+
+        // Every frame must lie between the radii and the index
+        for (const TrajectoryIndexEntry& entry : frames) {
+            if (entry.offset < chunksOffset || !frameFits(entry.offset, entry.byteSize, trailer.indexOffset)) {
+                std::cerr << "Trajectory index is corrupt, scanning chunks" << std::endl;
+                frames.clear();
+                scanChunks(chunksOffset);
+                break;
+            }
+        }
+    } else {
+        std::cerr << "Trajectory has no index, scanning chunks" << std::endl;
+        scanChunks(chunksOffset);
+    }
+    if (frames.empty()) {
+        std::cerr << "Trajectory contains no frames: " << path << std::endl;
+        exit(1);
+    }
+
+    config.numBalls = header.numBalls;
+    config.worldWidth = header.worldWidth;
+    config.worldHeight = header.worldHeight;
+    balls.assign(header.numBalls, Ball());
+    for (uint32_t i = 0; i < header.numBalls; i++) {
+        balls[i].radius = readRecord<float>(radiiOffset + sizeof(float) * i);
+    }
+    positions.resize(2 * header.numBalls);
+    if (header.encoding == TRAJECTORY_QUANTIZED) {
+        initTrajectoryCodec(codec, header.numBalls, header.precision, header.worldWidth, header.worldHeight);
+    }
+
+    playbackTime = frames.front().time;
+    decodeFrame(0);
+    std::cout << "Replaying " << frames.size() << " frames of " << header.numBalls << " balls, t="
+              << frames.front().time << " to " << frames.back().time << std::endl;
+}
+
+const std::vector<Ball>& advanceReplay(float deltaTime) {
+    if (!paused) {
+        playbackTime += deltaTime * playbackSpeed;
+
+        // Stop at the end of the recording in the direction of play
+        if ((playbackSpeed > 0.0 && playbackTime >= frames.back().time) ||
+            (playbackSpeed < 0.0 && playbackTime <= frames.front().time)) {
+            playbackTime = std::clamp(playbackTime, frames.front().time, frames.back().time);
+            paused = true;
+        }
+    }
+    decodeFrame(frameAt(playbackTime));
+    return balls;
+}
+
+void seekReplay(double time) {
+    playbackTime = std::clamp(time, frames.front().time, frames.back().time);
+    decodeFrame(frameAt(playbackTime));
+}
+
+double replayTime() {
+    return playbackTime;
+}
+
+void setReplaySpeed(double speed) {
+    playbackSpeed = speed;
+}
+
+double replaySpeed() {
+    return playbackSpeed;
+}
+
+void toggleReplayPause() {
+    paused = !paused;
+}
+
+void closeReplay() {
+    if (mappedData) {
+        munmap(const_cast<char*>(mappedData), mappedSize);
+        mappedData = nullptr;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <string>
+#include <vector>
+#include "ball_def.h"
+
+// Replay of recorded trajectories without running the simulation
+// The file is memory-mapped, so opening it costs only the index and frames
+// are decoded on demand as playback reaches them
+
+// Maps a trajectory file and sets config ball count and world size from it
+void openReplay(const std::string& path);
+
+// Advances the playback clock by deltaTime scaled by the playback speed
+// and returns the balls of the frame at the new time
+const std::vector<Ball>& advanceReplay(float deltaTime);
+
+// Jumps to the last frame at or before the given simulation time
+void seekReplay(double time);
+
+// Current playback position in simulation seconds
+double replayTime();
+
+// Playback speed as a multiple of real time; negative plays backwards
+void setReplaySpeed(double speed);
+double replaySpeed();
+
+void toggleReplayPause();
+
+// Unmaps the trajectory file
+void closeReplay();
+
+#endif // REPLAY_H
@@ -0,0 +1,244 @@
+#include "sim_config.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+SimConfig config;
+
+// Prints supported options
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --balls=N                            Number of balls (default 30)\n"
+              << "  --world=WxH                          World size (default 800x600)\n"
+              << "  --packing=F                          Size the world for ball area fraction F (max 0.5)\n"
+              << "  --log-balls                          Print every initial ball\n"
+              << "  --host-init                          Generate initial balls on the host\n"
+              << "  --seed=N                             Seed for the initial state (default random)\n"
+              << "  --solver=coloured|jacobi|sequential  Contact solver (default coloured)\n"
+              << "  --iterations=N                       Contact solver sweeps per frame (default 1)\n"
+              << "  --relaxation=F                       Jacobi relaxation factor (default 0.5)\n"
+              << "  --timestep=S                         Maximum time step in seconds (default 0.05)\n"
+              << "  --ccd                                Continuous collision detection for fast balls\n"
+              << "  --event-driven                       Event-driven simulation for sparse gases\n"
+              << "  --devices=N                          Split the world into strips over N OpenCL devices\n"
+              << "  --fission                            With --devices, split the main device instead\n"
+              << "  --rebalance-every=N                  Rebalance strips every N frames (default 300)\n"
+              << "  --checkpoint=FILE                    Write a checkpoint on exit\n"
+              << "  --checkpoint-every=N                 Also write the checkpoint every N frames\n"
+              << "  --restore=FILE                       Start from a checkpoint\n"
+              << "  --trajectory=FILE                    Record ball positions to a trajectory file\n"
+              << "  --trajectory-every=K                 Record every K frames (default 1)\n"
+              << "  --trajectory-precision=P             Compress positions quantized to P world units\n"
+              << "  --trace=FILE                         Write a Chrome trace-event timeline\n"
+              << "  --metrics=FILE                       Rewrite Prometheus metrics to FILE every second\n"
+              << "  --metrics-port=N                     Serve Prometheus metrics on 127.0.0.1:N\n"
+              << "  --render=mesh|sprites|lod            Ball drawing (default mesh)\n"
+              << "  --lod-pixels=P                       Smallest ball drawn as a circle by lod, in pixels (default 2)\n"
+              << "  --sync-render                        Step and draw in turn on one thread\n"
+              << "  --headless                           Run without a window\n"
+              << "  --frames=N                           Exit after N frames\n"
+              << "  --dump=DIR                           Write rendered frames to DIR\n"
+              << "  --dump-every=N                       Dump every N frames (default 1)\n"
+              << "  --dump-format=png|yuv                PNG files or one raw I420 file (default png)\n"
+              << "  --dump-threads=N                     Frame encoding threads (default: cores, up to 4)\n"
+              << "  --replay=FILE                        Play back a recorded trajectory\n"
+              << "  --replay-speed=S                     Playback speed multiple (default 1)\n"
+              << "  --help                               Show this message" << std::endl;
+}
+
+// Parses a strictly positive integer option value
+static int parsePositiveInt(const std::string& value, const std::string& option) {
+    char* end = nullptr;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed <= 0) {
+        std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+        exit(1);
+    }
+    return static_cast<int>(parsed);
+}
+
+// Checks that a file option has a value
+static std::string parsePath(const std::string& value, const std::string& option) {
+    if (value.empty()) {
+        std::cerr << "Missing file name for " << option << std::endl;
+        exit(1);
+    }
+    return value;
+}
+
+// Parses a strictly positive float option value
+static float parsePositiveFloat(const std::string& value, const std::string& option) {
+    char* end = nullptr;
+    float parsed = std::strtof(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !(parsed > 0.0f)) {
+        std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+        exit(1);
+    }
+    return parsed;
+}
+
+void parseCommandLine(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string option = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+
+        if (option == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        } else if (option == "--solver") {
+            if (value == "coloured" || value == "colored") {
+                config.solver = SolverMode::Coloured;
+            } else if (value == "jacobi") {
+                config.solver = SolverMode::Jacobi;
+            } else if (value == "sequential") {
+                config.solver = SolverMode::Sequential;
+            } else {
+                std::cerr << "Unknown solver: " << value << std::endl;
+                exit(1);
+            }
+        } else if (option == "--balls") {
+            config.numBalls = parsePositiveInt(value, option);
+        } else if (option == "--world") {
+            size_t x = value.find('x');
+            if (x == std::string::npos) {
+                std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+                exit(1);
+            }
+            config.worldWidth = parsePositiveFloat(value.substr(0, x), option);
+            config.worldHeight = parsePositiveFloat(value.substr(x + 1), option);
+        } else if (option == "--packing") {
+            config.packingFraction = parsePositiveFloat(value, option);
+            if (config.packingFraction > 0.5f) {
+                std::cerr << "Packing fraction must be in (0, 0.5]" << std::endl;
+                exit(1);
+            }
+        } else if (option == "--log-balls") {
+            config.logBalls = true;
+        } else if (option == "--host-init") {
+            config.hostInit = true;
+        } else if (option == "--seed") {
+            config.seed = static_cast<unsigned int>(parsePositiveInt(value, option));
+        } else if (option == "--iterations") {
+            config.solverIterations = parsePositiveInt(value, option);
+        } else if (option == "--relaxation") {
+            config.relaxation = parsePositiveFloat(value, option);
+            if (config.relaxation > 1.0f) {
+                std::cerr << "Relaxation factor must be in (0, 1]" << std::endl;
+                exit(1);
+            }
+        } else if (option == "--timestep") {
+            config.maxTimeStep = parsePositiveFloat(value, option);
+        } else if (option == "--ccd") {
+            config.continuousCollisions = true;
+        } else if (option == "--event-driven") {
+            config.eventDriven = true;
+        } else if (option == "--devices") {
+            config.devices = parsePositiveInt(value, option);
+        } else if (option == "--fission") {
+            config.deviceFission = true;
+        } else if (option == "--rebalance-every") {
+            config.rebalanceInterval = parsePositiveInt(value, option);
+        } else if (option == "--checkpoint") {
+            config.checkpointPath = parsePath(value, option);
+        } else if (option == "--checkpoint-every") {
+            config.checkpointInterval = parsePositiveInt(value, option);
+        } else if (option == "--restore") {
+            config.restorePath = parsePath(value, option);
+        } else if (option == "--trajectory") {
+            config.trajectoryPath = parsePath(value, option);
+        } else if (option == "--trajectory-every") {
+            config.trajectoryInterval = parsePositiveInt(value, option);
+        } else if (option == "--trajectory-precision") {
+            config.trajectoryPrecision = parsePositiveFloat(value, option);
+        } else if (option == "--trace") {
+            config.tracePath = parsePath(value, option);
+            config.profileKernels = true;
+        } else if (option == "--metrics") {
+            config.metricsPath = parsePath(value, option);
+            config.profileKernels = true;
+        } else if (option == "--metrics-port") {
+            config.metricsPort = parsePositiveInt(value, option);
+            if (config.metricsPort > 65535) {
+                std::cerr << "--metrics-port must be at most 65535" << std::endl;
+                exit(1);
+            }
+            config.profileKernels = true;
+        } else if (option == "--render") {
+            if (value == "mesh") {
+                config.renderMode = RenderMode::Mesh;
+            } else if (value == "sprites") {
+                config.renderMode = RenderMode::Sprites;
+            } else if (value == "lod") {
+                config.renderMode = RenderMode::Lod;
+            } else {
+                std::cerr << "Unknown render mode: " << value << std::endl;
+                exit(1);
+            }
+        } else if (option == "--lod-pixels") {
+            config.lodPixels = parsePositiveFloat(value, option);
+        } else if (option == "--sync-render") {
+            config.renderThread = false;
+        } else if (option == "--headless") {
+            config.headless = true;
+        } else if (option == "--frames") {
+            config.maxFrames = parsePositiveInt(value, option);
+        } else if (option == "--dump") {
+            config.dumpPath = parsePath(value, option);
+        } else if (option == "--dump-every") {
+            config.dumpInterval = parsePositiveInt(value, option);
+        } else if (option == "--dump-format") {
+            if (value == "png") {
+                config.dumpFormat = DumpFormat::Png;
+            } else if (value == "yuv") {
+                config.dumpFormat = DumpFormat::Yuv;
+            } else {
+                std::cerr << "Unknown dump format: " << value << std::endl;
+                exit(1);
+            }
+        } else if (option == "--dump-threads") {
+            config.dumpThreads = parsePositiveInt(value, option);
+        } else if (option == "--replay") {
+            config.replayPath = parsePath(value, option);
+        } else if (option == "--replay-speed") {
+            config.replaySpeed = parsePositiveFloat(value, option);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if (config.checkpointInterval > 0 && config.checkpointPath.empty()) {
+        std::cerr << "--checkpoint-every requires --checkpoint" << std::endl;
+        exit(1);
+    }
+
+    if (config.devices > 1 && config.eventDriven) {
+        std::cerr << "--devices cannot be combined with --event-driven" << std::endl;
+        exit(1);
+    }
+
+    if (config.deviceFission && config.devices < 2) {
+        std::cerr << "--fission requires --devices=N with N of at least 2" << std::endl;
+        exit(1);
+    }
+
+    if (config.continuousCollisions && config.solver == SolverMode::Sequential) {
+        std::cerr << "--ccd requires the coloured or jacobi solver" << std::endl;
+        exit(1);
+    }
+
+    if (config.dumpPath.empty() && (config.dumpInterval != 1 || config.dumpThreads != 0 ||
+                                    config.dumpFormat != DumpFormat::Png)) {
+        std::cerr << "--dump-every, --dump-format and --dump-threads require --dump" << std::endl;
+        exit(1);
+    }
+
+    // Replays only draw recorded positions to the window
+    if (!config.replayPath.empty() && (config.headless || !config.dumpPath.empty())) {
+        std::cerr << "--replay cannot be combined with --headless or --dump" << std::endl;
+        exit(1);
+    }
+}
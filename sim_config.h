@@ -0,0 +1,72 @@
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include <string>
+
+// Contact solver used for ball-to-ball collisions
+enum class SolverMode {
+    Sequential,  // Original checkBallCollisions kernel over candidate balls
+    Coloured,    // Graph-coloured Gauss-Seidel sweeps over the contact list
+    Jacobi       // Relaxed Jacobi iterations with atomic impulse accumulation
+};
+
+// How balls are drawn
+enum class RenderMode {
+    Mesh,     // Instanced 32-segment circle mesh, fill and outline
+    Sprites,  // One point per ball, disc and outline shaded per fragment
+    Lod       // Heat map of balls per pixel, circles only for the larger balls
+};
+
+// Frame dump encodings
+enum class DumpFormat {
+    Png,  // One PNG file per frame
+    Yuv   // Raw I420 frames appended to one file
+};
+
+// Runtime options, set from the command line
+struct SimConfig {
+    int numBalls = 30;
+    float worldWidth = 800.0f;  // Simulated world, mapped onto the window
+    float worldHeight = 600.0f;
+    SolverMode solver = SolverMode::Coloured;
+    int solverIterations = 1;   // Contact solver sweeps per frame
+    float relaxation = 0.5f;    // Jacobi impulse scale, in (0, 1]
+    float packingFraction = 0.0f;  // Sets the world size from the ball count when > 0
+    bool logBalls = false;      // Print every initial ball
+    bool hostInit = false;      // Generate initial balls on the host instead of the device
+    unsigned int seed = 0;      // Seeds the random number generator when nonzero
+    float maxTimeStep = 0.05f;  // Upper bound on the per-frame time step
+    bool continuousCollisions = false;  // Swept time-of-impact contact tests
+    bool eventDriven = false;   // Host event-driven simulation instead of time stepping
+    int devices = 1;            // OpenCL devices sharing the world in vertical strips
+    bool deviceFission = false;  // Strips on sub-devices of the main device
+    bool profileKernels = false;  // Record device timestamps of main pipeline kernels
+    int rebalanceInterval = 300;  // Frames between strip load balancing steps
+    std::string checkpointPath;  // Checkpoint written on exit and every checkpointInterval frames
+    int checkpointInterval = 0;
+    std::string restorePath;     // Checkpoint to start from instead of random balls
+    std::string trajectoryPath;  // Trajectory recorded every trajectoryInterval frames
+    int trajectoryInterval = 1;
+    float trajectoryPrecision = 0.0f;  // Quantization step; 0 records raw floats
+    std::string tracePath;       // Chrome trace of host spans and device kernels
+    std::string metricsPath;     // Prometheus metrics file, rewritten every second
+    int metricsPort = 0;         // Serves Prometheus metrics on localhost when > 0
+    std::string replayPath;      // Trajectory to play back instead of simulating
+    float replaySpeed = 1.0f;
+    RenderMode renderMode = RenderMode::Mesh;
+    float lodPixels = 2.0f;      // Smallest on-screen diameter drawn as a circle in Lod mode
+    bool renderThread = true;    // Draw on the main thread while another thread steps
+    bool headless = false;       // No window; frames only reach disk through dumpPath
+    long long maxFrames = 0;     // Frames to simulate before exiting; 0 runs until closed
+    std::string dumpPath;        // Directory receiving a frame every dumpInterval frames
+    int dumpInterval = 1;
+    DumpFormat dumpFormat = DumpFormat::Png;
+    int dumpThreads = 0;         // Frame encoding workers; 0 picks one per core, up to 4
+};
+
+extern SimConfig config;
+
+// Parses --option=value arguments into config, exits on invalid input
+void parseCommandLine(int argc, char** argv);
+
+#endif // SIM_CONFIG_H
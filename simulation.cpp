@@ -0,0 +1,1026 @@
+#include "simulation.h"
+#ifdef __APPLE__
+#include <OpenCL/cl_gl.h>
+#else
+#include <CL/cl_gl.h>
+#endif
+#include "sim_config.h"
+#include "placement.h"
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <map>
+
+// OpenCL Core Components
+cl_platform_id platform;
+cl_device_id device;
+cl_context context;
+cl_command_queue queue;
+cl_mem ballBuffer, vertexBuffer, statsBuffer;
+
+// Broad-phase grid size derived from the configured world
+int gridWidth, gridHeight;
+int contactSearchCells;  // Neighbourhood radius of the contact search, in cells
+
+// A profiled kernel launch and the host steady clock time it was enqueued at
+struct KernelLaunch {
+    cl_kernel kernel;
+    cl_event event;
+    cl_ulong hostQueued;
+};
+
+// Programs, kernels and buffers of the simulation on one device
+// Kernel arguments are per kernel object, so every pipeline has its own
+struct SimulationPipeline {
+    cl_device_id device;
+    cl_context context;
+    cl_command_queue queue;
+    int capacity;        // Balls the per-ball buffers hold
+    int numBalls;        // Balls simulated this frame
+    int maxContacts;     // Contact list capacity
+
+    cl_program gpuProgram, cpuProgram, compactProgram, contactProgram, initProgram;
+    cl_kernel gpuKernel, wallKernel, cpuKernel;  // Separate kernels simulate CPU/GPU tasks
+    cl_kernel vertexKernel;  // Packs balls into vertexBuffer for drawing
+    cl_kernel splatKernel;   // Level-of-detail density image and disc list
+    cl_mem ballBuffer, vertexBuffer, statsBuffer;
+    cl_mem previousPositionBuffer;  // Step-start positions for swept contact tests
+
+    // Active-set compaction kernels and buffers
+    cl_kernel classifyMotionKernel, countCellsKernel, classifyContactsKernel;
+    cl_kernel scanBlocksKernel, addBlockOffsetsKernel, scatterActiveKernel;
+    cl_mem movingFlagsBuffer, contactFlagsBuffer, wallFlagsBuffer, scanOffsetBuffer;
+    cl_mem movingListBuffer, contactListBuffer, wallListBuffer;
+    cl_mem activeCountBuffer, cellCountBuffer;
+    std::vector<cl_mem> scanLevelBuffers;  // Block totals for each scan level
+
+    // Active list sizes read back asynchronously to size the next dispatch
+    int hostActiveCounts[ACTIVE_LIST_COUNT];
+    int dispatchCounts[ACTIVE_LIST_COUNT];
+    cl_event activeCountEvent = nullptr;
+
+    // Cell-sorted broad phase and coloured contact solver kernels and buffers
+    cl_kernel binBallsKernel, findContactsKernel, claimContactsKernel;
+    cl_kernel assignColoursKernel, sortContactsKernel, solveColourKernel;
+    cl_mem cellStartBuffer, cellCursorBuffer, sortedBallBuffer;
+    cl_mem contactBuffer, colouredContactBuffer, contactColourBuffer, ballClaimBuffer;
+    cl_mem colourCountBuffer, colourOffsetBuffer, colourCursorBuffer;
+    cl_uint claimEpoch;  // Epoch of the last colouring round's ball claims
+
+    // Colour counts read back asynchronously to bound the next colouring
+    int hostColourCounts[MAX_CONTACT_COLOURS];
+    int usedColours;     // Colours in use at the last finished readback
+    int colourRounds;    // Colouring rounds run, and colours solved, this frame
+    cl_event colourCountEvent = nullptr;
+
+    // Jacobi contact solver kernels and per-ball accumulation buffers
+    cl_kernel accumulateImpulsesKernel, applyDeltasKernel;
+    cl_mem ballDeltaBuffer, ballContactCountBuffer;
+
+    // Initial state generation kernel
+    cl_kernel generateBallsKernel;
+
+    // Launches kept for takeKernelIntervals when the queue profiles
+    bool profiled = false;
+    std::vector<KernelLaunch> kernelLaunches;
+    std::map<cl_kernel, std::string> kernelNames;  // Function name of every kernel
+};
+
+// Pipeline on the main device, which owns ballBuffer
+SimulationPipeline* mainPipeline = nullptr;
+
+// The context shares objects with the window's GL context, and vertexBuffer
+// wraps the renderer's instance buffer
+bool glSharing = false;
+bool vertexBufferShared = false;
+
+// Level-of-detail density image and disc count, made on first use
+cl_mem densityBuffer = nullptr, discCountBuffer = nullptr;
+int densityPixels = 0;
+
+std::string readFile(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    return std::string(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+}
+
+void checkError(cl_int error, const char* operation) {
+    if (error != CL_SUCCESS) {
+        std::cerr << "Error during operation " << operation << ": " << error << std::endl;
+        exit(1);
+    }
+}
+
+// Builds a kernel program from the shared header plus a kernel source file
+cl_program buildProgram(cl_context programContext, cl_device_id programDevice, 
+                        const std::string& headerContent, const std::string& filename, 
+                        const char* label) {
+    cl_int error;
+    std::string combinedSource = headerContent + "\n" + readFile(filename);
+    const char* src = combinedSource.c_str();
+    size_t len = combinedSource.length();
+    cl_program builtProgram = clCreateProgramWithSource(programContext, 1, &src, &len, &error);
+    checkError(error, "creating program");
+    
+    error = clBuildProgram(builtProgram, 1, &programDevice, nullptr, nullptr, nullptr);
+    if (error != CL_SUCCESS) {
+        size_t logLen;
+        char buffer[2048];
+        clGetProgramBuildInfo(builtProgram, programDevice, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &logLen);
+        std::cerr << label << " Build error: " << buffer << std::endl;
+        exit(1);
+    }
+    return builtProgram;
+}
+
+// Creates every per-ball buffer of a pipeline for up to capacity balls
+void createPipelineBuffers(SimulationPipeline& p, int capacity) {
+    cl_int error;
+    p.capacity = capacity;
+    p.maxContacts = MAX_CONTACTS_PER_BALL * capacity;
+
+    // Create memory buffers
+    p.ballBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(Ball) * capacity, nullptr, &error);
+    checkError(error, "creating ball buffer");
+    p.vertexBuffer = clCreateBuffer(p.context, CL_MEM_WRITE_ONLY, sizeof(cl_float4) * capacity, nullptr, &error);
+    checkError(error, "creating vertex buffer");
+    p.statsBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int), nullptr, &error);
+    checkError(error, "creating stats buffer");
+    p.previousPositionBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(FLOAT2) * capacity, 
+                                              nullptr, &error);
+    checkError(error, "creating previous position buffer");
+
+    // Create active-set flag, offset and list buffers
+    cl_mem* perBallBuffers[] = {
+        &p.movingFlagsBuffer, &p.contactFlagsBuffer, &p.wallFlagsBuffer, &p.scanOffsetBuffer,
+        &p.movingListBuffer, &p.contactListBuffer, &p.wallListBuffer, &p.sortedBallBuffer
+    };
+    for (cl_mem* buffer : perBallBuffers) {
+        *buffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * capacity, nullptr, &error);
+        checkError(error, "creating active-set buffer");
+    }
+    p.activeCountBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * ACTIVE_LIST_COUNT, 
+                                         nullptr, &error);
+    checkError(error, "creating active count buffer");
+
+    // Create cell-sorted broad-phase buffers
+    cl_mem* cellBuffers[] = {&p.cellCountBuffer, &p.cellStartBuffer, &p.cellCursorBuffer};
+    for (cl_mem* buffer : cellBuffers) {
+        *buffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * gridWidth * gridHeight, 
+                                 nullptr, &error);
+        checkError(error, "creating cell buffer");
+    }
+
+    // Create contact list and colouring buffers
+    p.contactBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(Contact) * p.maxContacts, 
+                                     nullptr, &error);
+    checkError(error, "creating contact buffer");
+    p.colouredContactBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(Contact) * p.maxContacts, 
+                                             nullptr, &error);
+    checkError(error, "creating coloured contact buffer");
+    p.contactColourBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * p.maxContacts, 
+                                           nullptr, &error);
+    checkError(error, "creating contact colour buffer");
+    p.ballClaimBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_uint) * capacity, nullptr, &error);
+    checkError(error, "creating ball claim buffer");
+    if (p.maxContacts > (1 << CLAIM_PRIORITY_BITS)) {
+        std::cerr << "Error: " << capacity << " balls exceed the contact colouring limit" << std::endl;
+        exit(1);
+    }
+    cl_uint noClaim = 0;
+    error = clEnqueueFillBuffer(p.queue, p.ballClaimBuffer, &noClaim, sizeof(cl_uint), 0, 
+                               sizeof(cl_uint) * capacity, 0, nullptr, nullptr);
+    checkError(error, "clearing ball claims");
+    p.claimEpoch = 0;
+    cl_mem* colourBuffers[] = {&p.colourCountBuffer, &p.colourOffsetBuffer, &p.colourCursorBuffer};
+    for (cl_mem* buffer : colourBuffers) {
+        *buffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * MAX_CONTACT_COLOURS, 
+                                 nullptr, &error);
+        checkError(error, "creating colour buffer");
+    }
+
+    // Create Jacobi accumulation buffers; applyContactDeltas clears them after use
+    p.ballDeltaBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_float4) * capacity, 
+                                       nullptr, &error);
+    checkError(error, "creating ball delta buffer");
+    p.ballContactCountBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * capacity, 
+                                              nullptr, &error);
+    checkError(error, "creating ball contact count buffer");
+    cl_float zeroDelta = 0.0f;
+    cl_int zeroCount = 0;
+    error = clEnqueueFillBuffer(p.queue, p.ballDeltaBuffer, &zeroDelta, sizeof(cl_float), 0, 
+                               sizeof(cl_float4) * capacity, 0, nullptr, nullptr);
+    error |= clEnqueueFillBuffer(p.queue, p.ballContactCountBuffer, &zeroCount, sizeof(cl_int), 0, 
+                                sizeof(cl_int) * capacity, 0, nullptr, nullptr);
+    checkError(error, "clearing Jacobi buffers");
+
+    // One block-total buffer per scan level until a single block remains
+    // Scans cover per-ball flags, grid cells and colour counts
+    size_t blockSize = 2 * SCAN_GROUP_SIZE;
+    size_t levelSize = std::max({capacity, gridWidth * gridHeight, static_cast<int>(MAX_CONTACT_COLOURS)});
+    do {
+        levelSize = (levelSize + blockSize - 1) / blockSize;
+        cl_mem levelBuffer = clCreateBuffer(p.context, CL_MEM_READ_WRITE, sizeof(cl_int) * levelSize, 
+                                            nullptr, &error);
+        checkError(error, "creating scan level buffer");
+        p.scanLevelBuffers.push_back(levelBuffer);
+    } while (levelSize > 1);
+
+    // Launch every list-driven kernel over all balls until counts come back
+    std::fill(p.dispatchCounts, p.dispatchCounts + ACTIVE_LIST_COUNT, capacity);
+    p.usedColours = MAX_CONTACT_COLOURS;
+}
+
+// Every buffer made by createPipelineBuffers
+std::vector<cl_mem> pipelineBuffers(const SimulationPipeline& p) {
+    std::vector<cl_mem> buffers = {
+        p.ballBuffer, p.vertexBuffer, p.statsBuffer, p.previousPositionBuffer,
+        p.movingFlagsBuffer, p.contactFlagsBuffer, p.wallFlagsBuffer, p.scanOffsetBuffer,
+        p.movingListBuffer, p.contactListBuffer, p.wallListBuffer, p.activeCountBuffer, p.cellCountBuffer,
+        p.cellStartBuffer, p.cellCursorBuffer, p.sortedBallBuffer, p.contactBuffer, p.colouredContactBuffer,
+        p.contactColourBuffer, p.ballClaimBuffer, p.colourCountBuffer, p.colourOffsetBuffer, p.colourCursorBuffer,
+        p.ballDeltaBuffer, p.ballContactCountBuffer
+    };
+    buffers.insert(buffers.end(), p.scanLevelBuffers.begin(), p.scanLevelBuffers.end());
+    return buffers;
+}
+
+// Releases the buffers made by createPipelineBuffers
+void releasePipelineBuffers(SimulationPipeline& p) {
+    if (p.activeCountEvent) {
+        clWaitForEvents(1, &p.activeCountEvent);
+        clReleaseEvent(p.activeCountEvent);
+        p.activeCountEvent = nullptr;
+    }
+    if (p.colourCountEvent) {
+        clWaitForEvents(1, &p.colourCountEvent);
+        clReleaseEvent(p.colourCountEvent);
+        p.colourCountEvent = nullptr;
+    }
+    for (cl_mem buffer : pipelineBuffers(p)) {
+        clReleaseMemObject(buffer);
+    }
+    p.scanLevelBuffers.clear();
+}
+
+// Creates a kernel from a pipeline program and records its name for profiling
+cl_kernel createKernel(SimulationPipeline& p, cl_program program, const char* name, const char* operation) {
+    cl_int error;
+    cl_kernel kernel = clCreateKernel(program, name, &error);
+    checkError(error, operation);
+    p.kernelNames[kernel] = name;
+    return kernel;
+}
+
+// Enqueues a 1D launch of a pipeline kernel, keeping its event when profiled
+void enqueueKernel(SimulationPipeline& p, cl_kernel kernel, size_t globalSize, const size_t* localSize,
+                   const char* operation) {
+    cl_event event = nullptr;
+    cl_int error = clEnqueueNDRangeKernel(p.queue, kernel, 1, nullptr, &globalSize, localSize,
+                                         0, nullptr, p.profiled ? &event : nullptr);
+    checkError(error, operation);
+    if (event) {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        cl_ulong hostQueued = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+        p.kernelLaunches.push_back({kernel, event, hostQueued});
+    }
+}
+
+// Waits for and drops the pipeline's kept launch events
+void releaseKernelEvents(SimulationPipeline& p) {
+    for (KernelLaunch& launch : p.kernelLaunches) {
+        clWaitForEvents(1, &launch.event);
+        clReleaseEvent(launch.event);
+    }
+    p.kernelLaunches.clear();
+}
+
+SimulationPipeline* createPipeline(cl_context pipelineContext, cl_device_id pipelineDevice, 
+                                   cl_command_queue pipelineQueue, int capacity) {
+    SimulationPipeline* pipeline = new SimulationPipeline();
+    SimulationPipeline& p = *pipeline;
+    p.device = pipelineDevice;
+    p.context = pipelineContext;
+    p.queue = pipelineQueue;
+    p.numBalls = 0;
+
+    // Load shared header prepended to every kernel source
+    std::string headerContent = readFile("ball_def.h");
+    
+    // Build position update (simulated GPU work), collision detection
+    // (simulated CPU work) and active-set compaction programs
+    p.gpuProgram = buildProgram(p.context, p.device, headerContent, "gpu_kernel.cl", "GPU");
+    p.cpuProgram = buildProgram(p.context, p.device, headerContent, "cpu_kernel.cl", "CPU");
+    p.compactProgram = buildProgram(p.context, p.device, headerContent, "compact_kernel.cl", "Compaction");
+    p.contactProgram = buildProgram(p.context, p.device, headerContent, "contact_kernel.cl", "Contact");
+    p.initProgram = buildProgram(p.context, p.device, headerContent, "init_kernel.cl", "Init");
+
+    // Create kernels for position updates and collision detection
+    p.gpuKernel = createKernel(p, p.gpuProgram, "integrateBalls", "creating GPU kernel");
+    p.wallKernel = createKernel(p, p.gpuProgram, "resolveWallCollisions", "creating wall kernel");
+    p.cpuKernel = createKernel(p, p.cpuProgram, "checkBallCollisions", "creating CPU kernel");
+    p.vertexKernel = createKernel(p, p.gpuProgram, "writeBallVertices", "creating vertex kernel");
+    p.splatKernel = createKernel(p, p.gpuProgram, "splatBalls", "creating splat kernel");
+
+    // Create kernels that build the per-frame active lists
+    p.classifyMotionKernel = createKernel(p, p.compactProgram, "classifyMotion", 
+                                          "creating motion classification kernel");
+    p.countCellsKernel = createKernel(p, p.compactProgram, "countCellOccupancy", "creating cell count kernel");
+    p.classifyContactsKernel = createKernel(p, p.compactProgram, "classifyContacts", 
+                                            "creating contact classification kernel");
+    p.scanBlocksKernel = createKernel(p, p.compactProgram, "scanBlocks", "creating scan kernel");
+    p.addBlockOffsetsKernel = createKernel(p, p.compactProgram, "addBlockOffsets", "creating block offset kernel");
+    p.scatterActiveKernel = createKernel(p, p.compactProgram, "scatterActive", "creating scatter kernel");
+    p.binBallsKernel = createKernel(p, p.compactProgram, "binBallsByCell", "creating cell binning kernel");
+
+    // Create kernels that build, colour and solve the contact list
+    p.findContactsKernel = createKernel(p, p.contactProgram, "findContacts", "creating contact search kernel");
+    p.claimContactsKernel = createKernel(p, p.contactProgram, "claimContactBalls", "creating contact claim kernel");
+    p.assignColoursKernel = createKernel(p, p.contactProgram, "assignContactColours", 
+                                         "creating colour assignment kernel");
+    p.sortContactsKernel = createKernel(p, p.contactProgram, "sortContactsByColour", "creating contact sort kernel");
+    p.solveColourKernel = createKernel(p, p.contactProgram, "solveContactColour", "creating colour solve kernel");
+    p.accumulateImpulsesKernel = createKernel(p, p.contactProgram, "accumulateContactImpulses", 
+                                              "creating impulse accumulation kernel");
+    p.applyDeltasKernel = createKernel(p, p.contactProgram, "applyContactDeltas", 
+                                       "creating delta application kernel");
+    p.generateBallsKernel = createKernel(p, p.initProgram, "generateBalls", "creating ball generation kernel");
+
+    createPipelineBuffers(p, capacity);
+    return pipeline;
+}
+
+void reservePipelineBalls(SimulationPipeline* pipeline, int numBalls) {
+    if (numBalls <= pipeline->capacity) return;
+
+    // Grow geometrically so a drifting ball count does not reallocate every frame
+    clFinish(pipeline->queue);
+    releasePipelineBuffers(*pipeline);
+    createPipelineBuffers(*pipeline, numBalls + numBalls / 2);
+}
+
+cl_mem pipelineBallBuffer(SimulationPipeline* pipeline) {
+    return pipeline->ballBuffer;
+}
+
+size_t pipelineDeviceBytes(SimulationPipeline* pipeline) {
+    size_t total = 0;
+    for (cl_mem buffer : pipelineBuffers(*pipeline)) {
+        size_t bytes = 0;
+        clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(bytes), &bytes, nullptr);
+        total += bytes;
+    }
+    return total;
+}
+
+void releasePipeline(SimulationPipeline* pipeline) {
+    SimulationPipeline& p = *pipeline;
+    releaseKernelEvents(p);
+    releasePipelineBuffers(p);
+    cl_kernel kernels[] = {
+        p.gpuKernel, p.wallKernel, p.cpuKernel, p.vertexKernel, p.splatKernel,
+        p.classifyMotionKernel, p.countCellsKernel, p.classifyContactsKernel,
+        p.scanBlocksKernel, p.addBlockOffsetsKernel, p.scatterActiveKernel, p.binBallsKernel,
+        p.findContactsKernel, p.claimContactsKernel, p.assignColoursKernel, p.sortContactsKernel,
+        p.solveColourKernel, p.accumulateImpulsesKernel, p.applyDeltasKernel, p.generateBallsKernel
+    };
+    for (cl_kernel kernel : kernels) {
+        clReleaseKernel(kernel);
+    }
+    cl_program programs[] = {p.gpuProgram, p.cpuProgram, p.compactProgram, p.contactProgram, p.initProgram};
+    for (cl_program program : programs) {
+        clReleaseProgram(program);
+    }
+    delete pipeline;
+}
+
+// Whether the device can share buffers with OpenGL
+bool deviceSupportsGLSharing(cl_device_id sharingDevice) {
+    size_t length = 0;
+    clGetDeviceInfo(sharingDevice, CL_DEVICE_EXTENSIONS, 0, nullptr, &length);
+    std::string extensions(length, '\0');
+    clGetDeviceInfo(sharingDevice, CL_DEVICE_EXTENSIONS, length, &extensions[0], nullptr);
+    return extensions.find("cl_khr_gl_sharing") != std::string::npos ||
+           extensions.find("cl_APPLE_gl_sharing") != std::string::npos;
+}
+
+// Sets up OpenCL environment and creates kernels
+// For M1: Uses CL_DEVICE_TYPE_DEFAULT instead of separate CPU/GPU devices
+void initOpenCL(int capacity, const std::vector<cl_context_properties>& glProperties) {
+    cl_int error;
+
+    // Get platform
+    cl_uint numPlatforms;
+    error = clGetPlatformIDs(1, &platform, &numPlatforms);
+    checkError(error, "getting platform ID");
+
+    // Print platform info for debugging
+    char platformName[128];
+    error = clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof(platformName), 
+                             platformName, nullptr);
+    checkError(error, "getting platform info");
+    std::cout << "OpenCL Platform: " << platformName << std::endl;
+
+    // M1 Configuration: Use default device type
+    error = clGetDeviceIDs(platform, CL_DEVICE_TYPE_DEFAULT, 1, &device, nullptr);
+    checkError(error, "getting device");
+
+    // Print device info for debugging
+    char deviceName[128];
+    error = clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), 
+                           deviceName, nullptr);
+    checkError(error, "getting device info");
+    std::cout << "OpenCL Device: " << deviceName << std::endl;
+
+    // Create OpenCL context, sharing the GL context when the device allows it
+    std::vector<cl_context_properties> properties = {
+        CL_CONTEXT_PLATFORM, (cl_context_properties)platform
+    };
+    glSharing = false;
+    if (!glProperties.empty() && deviceSupportsGLSharing(device)) {
+        std::vector<cl_context_properties> sharingProperties = properties;
+        sharingProperties.insert(sharingProperties.end(), glProperties.begin(), glProperties.end());
+        sharingProperties.push_back(0);
+        context = clCreateContext(sharingProperties.data(), 1, &device, nullptr, nullptr, &error);
+        glSharing = error == CL_SUCCESS;
+    }
+    if (!glSharing) {
+        if (!glProperties.empty()) {
+            std::cout << "OpenCL/OpenGL sharing unavailable, balls are read back for drawing" << std::endl;
+        }
+        properties.push_back(0);
+        context = clCreateContext(properties.data(), 1, &device, nullptr, nullptr, &error);
+        checkError(error, "creating context");
+    }
+
+    // Create command queue for kernel execution, timing every command if asked
+    cl_command_queue_properties queueProperties = config.profileKernels ? CL_QUEUE_PROFILING_ENABLE : 0;
+    queue = clCreateCommandQueue(context, device, queueProperties, &error);
+    checkError(error, "creating command queue");
+
+    // Size the broad-phase grid for the configured world
+    gridWidth = static_cast<int>(std::ceil(config.worldWidth / CELL_SIZE));
+    gridHeight = static_cast<int>(std::ceil(config.worldHeight / CELL_SIZE));
+
+    // Swept contacts may end a step up to two travel distances further apart
+    float searchReach = 2.0f * MAX_RADIUS;
+    if (config.continuousCollisions) {
+        searchReach += 2.0f * MAX_SPEED * config.maxTimeStep;
+    }
+    contactSearchCells = static_cast<int>(std::ceil(searchReach / CELL_SIZE));
+
+    // The main pipeline simulates the whole world in ballBuffer
+    mainPipeline = createPipeline(context, device, queue, capacity);
+    mainPipeline->numBalls = capacity;
+    mainPipeline->profiled = config.profileKernels;
+    ballBuffer = mainPipeline->ballBuffer;
+    vertexBuffer = mainPipeline->vertexBuffer;
+    statsBuffer = mainPipeline->statsBuffer;
+}
+
+// Exclusive prefix sum of n ints on the device, recursing over block totals
+void scanBuffer(SimulationPipeline& p, cl_mem input, cl_mem output, int n, size_t level = 0) {
+    const int blockSize = static_cast<int>(2 * SCAN_GROUP_SIZE);
+    int numBlocks = (n + blockSize - 1) / blockSize;
+    cl_mem blockSums = p.scanLevelBuffers[level];
+
+    cl_int error = clSetKernelArg(p.scanBlocksKernel, 0, sizeof(cl_mem), &input);
+    error |= clSetKernelArg(p.scanBlocksKernel, 1, sizeof(cl_mem), &output);
+    error |= clSetKernelArg(p.scanBlocksKernel, 2, sizeof(cl_mem), &blockSums);
+    error |= clSetKernelArg(p.scanBlocksKernel, 3, sizeof(int), &n);
+    error |= clSetKernelArg(p.scanBlocksKernel, 4, sizeof(cl_int) * blockSize, nullptr);
+    checkError(error, "setting scan kernel arguments");
+
+    size_t globalSize = numBlocks * SCAN_GROUP_SIZE;
+    enqueueKernel(p, p.scanBlocksKernel, globalSize, &SCAN_GROUP_SIZE, "enqueueing scan kernel");
+
+    if (numBlocks == 1) return;
+
+    // Scan block totals in place, then add them back onto every block
+    scanBuffer(p, blockSums, blockSums, numBlocks, level + 1);
+
+    error = clSetKernelArg(p.addBlockOffsetsKernel, 0, sizeof(cl_mem), &output);
+    error |= clSetKernelArg(p.addBlockOffsetsKernel, 1, sizeof(cl_mem), &blockSums);
+    error |= clSetKernelArg(p.addBlockOffsetsKernel, 2, sizeof(int), &n);
+    error |= clSetKernelArg(p.addBlockOffsetsKernel, 3, sizeof(int), &blockSize);
+    checkError(error, "setting block offset kernel arguments");
+
+    globalSize = n;
+    enqueueKernel(p, p.addBlockOffsetsKernel, globalSize, nullptr, "enqueueing block offset kernel");
+}
+
+// Compacts a per-ball flag array into a sorted index list and its device-side size
+void compactActiveList(SimulationPipeline& p, cl_mem flags, cl_mem activeList, int slot) {
+    scanBuffer(p, flags, p.scanOffsetBuffer, p.numBalls);
+
+    cl_int error = clSetKernelArg(p.scatterActiveKernel, 0, sizeof(cl_mem), &flags);
+    error |= clSetKernelArg(p.scatterActiveKernel, 1, sizeof(cl_mem), &p.scanOffsetBuffer);
+    error |= clSetKernelArg(p.scatterActiveKernel, 2, sizeof(int), &p.numBalls);
+    error |= clSetKernelArg(p.scatterActiveKernel, 3, sizeof(cl_mem), &activeList);
+    error |= clSetKernelArg(p.scatterActiveKernel, 4, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.scatterActiveKernel, 5, sizeof(int), &slot);
+    checkError(error, "setting scatter kernel arguments");
+
+    size_t globalSize = p.numBalls;
+    enqueueKernel(p, p.scatterActiveKernel, globalSize, nullptr, "enqueueing scatter kernel");
+}
+
+// Launch size for a list-driven kernel, taken from the last list size that
+// finished reading back. Kernels loop over the true device-side size, so a
+// stale value only costs extra loop iterations or idle work-items.
+size_t activeDispatchSize(SimulationPipeline& p, int slot) {
+    if (p.activeCountEvent) {
+        cl_int status;
+        clGetEventInfo(p.activeCountEvent, CL_EVENT_COMMAND_EXECUTION_STATUS, 
+                       sizeof(status), &status, nullptr);
+        if (status == CL_COMPLETE) {
+            std::copy(p.hostActiveCounts, p.hostActiveCounts + ACTIVE_LIST_COUNT, p.dispatchCounts);
+            clReleaseEvent(p.activeCountEvent);
+            p.activeCountEvent = nullptr;
+        }
+    }
+    // Leave headroom for lists that grew since the last readback
+    int count = p.dispatchCounts[slot] + p.dispatchCounts[slot] / 4 + 1;
+    return static_cast<size_t>(std::min(count, p.numBalls));
+}
+
+// Starts a non-blocking readback of the active list sizes
+void requestActiveCounts(SimulationPipeline& p) {
+    if (p.activeCountEvent) return;  // Previous readback still in flight
+    cl_int error = clEnqueueReadBuffer(p.queue, p.activeCountBuffer, CL_FALSE, 0, 
+                                      sizeof(p.hostActiveCounts), p.hostActiveCounts, 
+                                      0, nullptr, &p.activeCountEvent);
+    checkError(error, "reading active counts");
+}
+
+// Sorts ball indices by grid cell from the cell counts of this frame
+void buildCellLists(SimulationPipeline& p) {
+    scanBuffer(p, p.cellCountBuffer, p.cellStartBuffer, gridWidth * gridHeight);
+    cl_int error = clEnqueueCopyBuffer(p.queue, p.cellStartBuffer, p.cellCursorBuffer, 0, 0, 
+                                      sizeof(cl_int) * gridWidth * gridHeight, 0, nullptr, nullptr);
+    checkError(error, "copying cell cursors");
+
+    error = clSetKernelArg(p.binBallsKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.binBallsKernel, 1, sizeof(int), &p.numBalls);
+    error |= clSetKernelArg(p.binBallsKernel, 2, sizeof(float), &CELL_SIZE);
+    error |= clSetKernelArg(p.binBallsKernel, 3, sizeof(int), &gridWidth);
+    error |= clSetKernelArg(p.binBallsKernel, 4, sizeof(int), &gridHeight);
+    error |= clSetKernelArg(p.binBallsKernel, 5, sizeof(cl_mem), &p.cellCursorBuffer);
+    error |= clSetKernelArg(p.binBallsKernel, 6, sizeof(cl_mem), &p.sortedBallBuffer);
+    checkError(error, "setting cell binning kernel arguments");
+
+    size_t globalSize = p.numBalls;
+    enqueueKernel(p, p.binBallsKernel, globalSize, nullptr, "enqueueing cell binning kernel");
+}
+
+// Appends every overlapping pair around the candidate balls to the contact list,
+// plus pairs whose swept paths touched when continuous collisions are enabled
+void buildContactList(SimulationPipeline& p, float deltaTime) {
+    cl_int zeroCount = 0;
+    cl_int error = clEnqueueFillBuffer(p.queue, p.activeCountBuffer, &zeroCount, sizeof(cl_int), 
+                                      sizeof(cl_int) * ACTIVE_PAIRS, sizeof(cl_int), 0, nullptr, nullptr);
+    checkError(error, "clearing contact count");
+
+    int sweptContacts = config.continuousCollisions ? 1 : 0;
+
+    error = clSetKernelArg(p.findContactsKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 1, sizeof(cl_mem), &p.contactListBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 2, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 3, sizeof(cl_mem), &p.cellStartBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 4, sizeof(cl_mem), &p.cellCountBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 5, sizeof(cl_mem), &p.sortedBallBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 6, sizeof(float), &CELL_SIZE);
+    error |= clSetKernelArg(p.findContactsKernel, 7, sizeof(int), &gridWidth);
+    error |= clSetKernelArg(p.findContactsKernel, 8, sizeof(int), &gridHeight);
+    error |= clSetKernelArg(p.findContactsKernel, 9, sizeof(int), &contactSearchCells);
+    error |= clSetKernelArg(p.findContactsKernel, 10, sizeof(cl_mem), &p.previousPositionBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 11, sizeof(int), &sweptContacts);
+    error |= clSetKernelArg(p.findContactsKernel, 12, sizeof(float), &deltaTime);
+    error |= clSetKernelArg(p.findContactsKernel, 13, sizeof(cl_mem), &p.contactBuffer);
+    error |= clSetKernelArg(p.findContactsKernel, 14, sizeof(int), &p.maxContacts);
+    checkError(error, "setting contact search kernel arguments");
+
+    size_t activeSize = activeDispatchSize(p, ACTIVE_CONTACT);
+    enqueueKernel(p, p.findContactsKernel, activeSize, nullptr, "enqueueing contact search kernel");
+}
+
+// Colouring rounds for this frame, from the last colour counts that finished
+// reading back. Contacts the rounds leave uncoloured wait a frame, as they do
+// once MAX_CONTACT_COLOURS runs out, and the headroom catches up as the
+// contact graph grows.
+int colourRoundCount(SimulationPipeline& p) {
+    if (p.colourCountEvent) {
+        cl_int status;
+        clGetEventInfo(p.colourCountEvent, CL_EVENT_COMMAND_EXECUTION_STATUS, 
+                       sizeof(status), &status, nullptr);
+        if (status == CL_COMPLETE) {
+            p.usedColours = 0;
+            for (int colour = 0; colour < MAX_CONTACT_COLOURS; colour++) {
+                if (p.hostColourCounts[colour] > 0) p.usedColours = colour + 1;
+            }
+            clReleaseEvent(p.colourCountEvent);
+            p.colourCountEvent = nullptr;
+        }
+    }
+    return std::min(p.usedColours + p.usedColours / 4 + 1, static_cast<int>(MAX_CONTACT_COLOURS));
+}
+
+// Starts a non-blocking readback of the contacts per colour
+void requestColourCounts(SimulationPipeline& p) {
+    if (p.colourCountEvent) return;  // Previous readback still in flight
+    cl_int error = clEnqueueReadBuffer(p.queue, p.colourCountBuffer, CL_FALSE, 0, 
+                                      sizeof(p.hostColourCounts), p.hostColourCounts, 
+                                      0, nullptr, &p.colourCountEvent);
+    checkError(error, "reading colour counts");
+}
+
+// Colours the contact graph so contacts sharing a ball differ in colour,
+// then groups the contact list by colour
+void colourContacts(SimulationPipeline& p) {
+    cl_int uncoloured = -1;
+    cl_int zeroCount = 0;
+    cl_int error = clEnqueueFillBuffer(p.queue, p.contactColourBuffer, &uncoloured, sizeof(cl_int), 0, 
+                                      sizeof(cl_int) * p.maxContacts, 0, nullptr, nullptr);
+    error |= clEnqueueFillBuffer(p.queue, p.colourCountBuffer, &zeroCount, sizeof(cl_int), 0, 
+                                sizeof(cl_int) * MAX_CONTACT_COLOURS, 0, nullptr, nullptr);
+    checkError(error, "clearing contact colours");
+
+    error = clSetKernelArg(p.claimContactsKernel, 0, sizeof(cl_mem), &p.contactBuffer);
+    error |= clSetKernelArg(p.claimContactsKernel, 1, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.claimContactsKernel, 2, sizeof(int), &p.maxContacts);
+    error |= clSetKernelArg(p.claimContactsKernel, 3, sizeof(cl_mem), &p.contactColourBuffer);
+    error |= clSetKernelArg(p.claimContactsKernel, 4, sizeof(cl_mem), &p.ballClaimBuffer);
+    error |= clSetKernelArg(p.assignColoursKernel, 0, sizeof(cl_mem), &p.contactBuffer);
+    error |= clSetKernelArg(p.assignColoursKernel, 1, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.assignColoursKernel, 2, sizeof(int), &p.maxContacts);
+    error |= clSetKernelArg(p.assignColoursKernel, 3, sizeof(cl_mem), &p.contactColourBuffer);
+    error |= clSetKernelArg(p.assignColoursKernel, 4, sizeof(cl_mem), &p.ballClaimBuffer);
+    error |= clSetKernelArg(p.assignColoursKernel, 6, sizeof(cl_mem), &p.colourCountBuffer);
+    checkError(error, "setting colouring kernel arguments");
+
+    // Each round colours an independent set of the still uncoloured contacts
+    // Claims only need clearing when the epoch wraps, every CLAIM_EPOCHS - 1 rounds
+    size_t activeSize = activeDispatchSize(p, ACTIVE_PAIRS);
+    p.colourRounds = colourRoundCount(p);
+    for (int round = 0; round < p.colourRounds; round++) {
+        if (++p.claimEpoch == CLAIM_EPOCHS) {
+            cl_uint noClaim = 0;
+            error = clEnqueueFillBuffer(p.queue, p.ballClaimBuffer, &noClaim, sizeof(cl_uint), 0, 
+                                       sizeof(cl_uint) * p.numBalls, 0, nullptr, nullptr);
+            checkError(error, "clearing ball claims");
+            p.claimEpoch = 1;
+        }
+
+        error = clSetKernelArg(p.claimContactsKernel, 5, sizeof(int), &round);
+        error |= clSetKernelArg(p.claimContactsKernel, 6, sizeof(cl_uint), &p.claimEpoch);
+        error |= clSetKernelArg(p.assignColoursKernel, 5, sizeof(int), &round);
+        error |= clSetKernelArg(p.assignColoursKernel, 7, sizeof(cl_uint), &p.claimEpoch);
+        checkError(error, "setting colouring round");
+
+        enqueueKernel(p, p.claimContactsKernel, activeSize, nullptr, "enqueueing contact claim kernel");
+        enqueueKernel(p, p.assignColoursKernel, activeSize, nullptr, "enqueueing colour assignment kernel");
+    }
+
+    // Counting sort of contacts by colour
+    scanBuffer(p, p.colourCountBuffer, p.colourOffsetBuffer, MAX_CONTACT_COLOURS);
+    error = clEnqueueCopyBuffer(p.queue, p.colourOffsetBuffer, p.colourCursorBuffer, 0, 0, 
+                               sizeof(cl_int) * MAX_CONTACT_COLOURS, 0, nullptr, nullptr);
+    checkError(error, "copying colour cursors");
+
+    error = clSetKernelArg(p.sortContactsKernel, 0, sizeof(cl_mem), &p.contactBuffer);
+    error |= clSetKernelArg(p.sortContactsKernel, 1, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.sortContactsKernel, 2, sizeof(int), &p.maxContacts);
+    error |= clSetKernelArg(p.sortContactsKernel, 3, sizeof(cl_mem), &p.contactColourBuffer);
+    error |= clSetKernelArg(p.sortContactsKernel, 4, sizeof(cl_mem), &p.colourCursorBuffer);
+    error |= clSetKernelArg(p.sortContactsKernel, 5, sizeof(cl_mem), &p.colouredContactBuffer);
+    checkError(error, "setting contact sort kernel arguments");
+
+    enqueueKernel(p, p.sortContactsKernel, activeSize, nullptr, "enqueueing contact sort kernel");
+    requestColourCounts(p);
+}
+
+// Gauss-Seidel sweeps over the colours; each colour is one launch, and the
+// in-order p.queue orders colours since OpenCL has no device-wide barrier
+void solveColouredContacts(SimulationPipeline& p) {
+    cl_int error = clSetKernelArg(p.solveColourKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.solveColourKernel, 1, sizeof(cl_mem), &p.colouredContactBuffer);
+    error |= clSetKernelArg(p.solveColourKernel, 2, sizeof(cl_mem), &p.colourOffsetBuffer);
+    error |= clSetKernelArg(p.solveColourKernel, 3, sizeof(cl_mem), &p.colourCountBuffer);
+    error |= clSetKernelArg(p.solveColourKernel, 5, sizeof(cl_mem), &p.statsBuffer);
+    checkError(error, "setting colour solve kernel arguments");
+
+    // A colour touches disjoint balls, so it never holds more than half of them
+    size_t activeSize = std::min(activeDispatchSize(p, ACTIVE_PAIRS), 
+                                 static_cast<size_t>(p.numBalls / 2 + 1));
+    // Colours past this frame's colouring rounds are empty
+    for (int iteration = 0; iteration < config.solverIterations; iteration++) {
+        for (int colour = 0; colour < p.colourRounds; colour++) {
+            error = clSetKernelArg(p.solveColourKernel, 4, sizeof(int), &colour);
+            checkError(error, "setting solved colour");
+            enqueueKernel(p, p.solveColourKernel, activeSize, nullptr, "enqueueing colour solve kernel");
+        }
+    }
+}
+
+// Relaxed Jacobi iterations: contacts scatter impulses from the previous
+// iteration's state into per-ball deltas, then every ball applies its sum
+void solveJacobiContacts(SimulationPipeline& p) {
+    cl_int error = clSetKernelArg(p.accumulateImpulsesKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.accumulateImpulsesKernel, 1, sizeof(cl_mem), &p.contactBuffer);
+    error |= clSetKernelArg(p.accumulateImpulsesKernel, 2, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.accumulateImpulsesKernel, 3, sizeof(int), &p.maxContacts);
+    error |= clSetKernelArg(p.accumulateImpulsesKernel, 4, sizeof(cl_mem), &p.ballDeltaBuffer);
+    error |= clSetKernelArg(p.accumulateImpulsesKernel, 5, sizeof(cl_mem), &p.ballContactCountBuffer);
+    error |= clSetKernelArg(p.accumulateImpulsesKernel, 6, sizeof(cl_mem), &p.statsBuffer);
+    checkError(error, "setting impulse accumulation kernel arguments");
+
+    error = clSetKernelArg(p.applyDeltasKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.applyDeltasKernel, 1, sizeof(cl_mem), &p.contactListBuffer);
+    error |= clSetKernelArg(p.applyDeltasKernel, 2, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.applyDeltasKernel, 3, sizeof(cl_mem), &p.ballDeltaBuffer);
+    error |= clSetKernelArg(p.applyDeltasKernel, 4, sizeof(cl_mem), &p.ballContactCountBuffer);
+    error |= clSetKernelArg(p.applyDeltasKernel, 5, sizeof(float), &config.relaxation);
+    checkError(error, "setting delta application kernel arguments");
+
+    size_t pairSize = activeDispatchSize(p, ACTIVE_PAIRS);
+    size_t ballSize = activeDispatchSize(p, ACTIVE_CONTACT);
+    for (int iteration = 0; iteration < config.solverIterations; iteration++) {
+        enqueueKernel(p, p.accumulateImpulsesKernel, pairSize, nullptr,
+                      "enqueueing impulse accumulation kernel");
+        enqueueKernel(p, p.applyDeltasKernel, ballSize, nullptr, "enqueueing delta application kernel");
+    }
+}
+
+void generateBallsOnDevice(cl_ulong seed) {
+    SimulationPipeline& p = *mainPipeline;
+    int columns, rows;
+    placementGrid(columns, rows);
+    cl_uint cellCount = static_cast<cl_uint>(columns) * rows;
+
+    // The cell permutation runs on the smallest even-width power of two that
+    // covers every cell, so cycle-walking needs under four steps on average
+    int halfBits = 0;
+    while ((1ull << (2 * halfBits)) < cellCount) halfBits++;
+
+    cl_uint2 key = {{static_cast<cl_uint>(seed), static_cast<cl_uint>(seed >> 32)}};
+    cl_int error = clSetKernelArg(p.generateBallsKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.generateBallsKernel, 1, sizeof(int), &p.numBalls);
+    error |= clSetKernelArg(p.generateBallsKernel, 2, sizeof(cl_uint2), &key);
+    error |= clSetKernelArg(p.generateBallsKernel, 3, sizeof(int), &columns);
+    error |= clSetKernelArg(p.generateBallsKernel, 4, sizeof(cl_uint), &cellCount);
+    error |= clSetKernelArg(p.generateBallsKernel, 5, sizeof(int), &halfBits);
+    error |= clSetKernelArg(p.generateBallsKernel, 6, sizeof(float), &PLACEMENT_CELL);
+    error |= clSetKernelArg(p.generateBallsKernel, 7, sizeof(float), &MAX_INITIAL_VELOCITY);
+    checkError(error, "setting ball generation kernel arguments");
+
+    size_t globalSize = p.numBalls;
+    enqueueKernel(p, p.generateBallsKernel, globalSize, nullptr, "enqueueing ball generation kernel");
+}
+
+void simulatePipelineFrame(SimulationPipeline* pipeline, int numBalls, float deltaTime) {
+    SimulationPipeline& p = *pipeline;
+    p.numBalls = numBalls;
+    if (numBalls == 0) return;
+
+    // Reset collision detection counter; a fill does not block the host, so
+    // the frame is enqueued while the previous one still runs
+    cl_int zero = 0;
+    cl_int error = clEnqueueFillBuffer(p.queue, p.statsBuffer, &zero, sizeof(cl_int), 0, 
+                                      sizeof(cl_int), 0, nullptr, nullptr);
+    checkError(error, "clearing stats buffer");
+
+    FLOAT2 boundaries = {config.worldWidth, config.worldHeight};
+    size_t globalSize = p.numBalls;
+
+    // Build active lists of moving balls and balls near walls
+    error = clSetKernelArg(p.classifyMotionKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.classifyMotionKernel, 1, sizeof(int), &p.numBalls);
+    error |= clSetKernelArg(p.classifyMotionKernel, 2, sizeof(float), &deltaTime);
+    error |= clSetKernelArg(p.classifyMotionKernel, 3, sizeof(FLOAT2), &boundaries);
+    error |= clSetKernelArg(p.classifyMotionKernel, 4, sizeof(cl_mem), &p.movingFlagsBuffer);
+    error |= clSetKernelArg(p.classifyMotionKernel, 5, sizeof(cl_mem), &p.wallFlagsBuffer);
+    error |= clSetKernelArg(p.classifyMotionKernel, 6, sizeof(cl_mem), &p.previousPositionBuffer);
+    checkError(error, "setting motion classification kernel arguments");
+    
+    enqueueKernel(p, p.classifyMotionKernel, globalSize, nullptr, "enqueueing motion classification kernel");
+    compactActiveList(p, p.movingFlagsBuffer, p.movingListBuffer, ACTIVE_MOVING);
+    compactActiveList(p, p.wallFlagsBuffer, p.wallListBuffer, ACTIVE_WALL);
+
+    // Simulate GPU work: Update moving ball positions in parallel
+    // On M1, this runs on unified memory but simulates GPU parallel processing
+    error = clSetKernelArg(p.gpuKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.gpuKernel, 1, sizeof(cl_mem), &p.movingListBuffer);
+    error |= clSetKernelArg(p.gpuKernel, 2, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.gpuKernel, 3, sizeof(float), &deltaTime);
+    checkError(error, "setting GPU kernel arguments");
+    
+    size_t activeSize = activeDispatchSize(p, ACTIVE_MOVING);
+    enqueueKernel(p, p.gpuKernel, activeSize, nullptr, "enqueueing GPU kernel");
+
+    // Resolve wall collisions for balls that may have reached a wall
+    error = clSetKernelArg(p.wallKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.wallKernel, 1, sizeof(cl_mem), &p.wallListBuffer);
+    error |= clSetKernelArg(p.wallKernel, 2, sizeof(cl_mem), &p.activeCountBuffer);
+    error |= clSetKernelArg(p.wallKernel, 3, sizeof(FLOAT2), &boundaries);
+    checkError(error, "setting wall kernel arguments");
+    
+    activeSize = activeDispatchSize(p, ACTIVE_WALL);
+    enqueueKernel(p, p.wallKernel, activeSize, nullptr, "enqueueing wall kernel");
+
+    // Build active list of balls with candidate contacts on the moved positions
+    cl_int zeroCount = 0;
+    error = clEnqueueFillBuffer(p.queue, p.cellCountBuffer, &zeroCount, sizeof(cl_int), 0, 
+                               sizeof(cl_int) * gridWidth * gridHeight, 0, nullptr, nullptr);
+    checkError(error, "clearing cell counts");
+
+    error = clSetKernelArg(p.countCellsKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.countCellsKernel, 1, sizeof(int), &p.numBalls);
+    error |= clSetKernelArg(p.countCellsKernel, 2, sizeof(float), &CELL_SIZE);
+    error |= clSetKernelArg(p.countCellsKernel, 3, sizeof(int), &gridWidth);
+    error |= clSetKernelArg(p.countCellsKernel, 4, sizeof(int), &gridHeight);
+    error |= clSetKernelArg(p.countCellsKernel, 5, sizeof(cl_mem), &p.cellCountBuffer);
+    checkError(error, "setting cell count kernel arguments");
+    
+    enqueueKernel(p, p.countCellsKernel, globalSize, nullptr, "enqueueing cell count kernel");
+
+    error = clSetKernelArg(p.classifyContactsKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.classifyContactsKernel, 1, sizeof(int), &p.numBalls);
+    error |= clSetKernelArg(p.classifyContactsKernel, 2, sizeof(float), &CELL_SIZE);
+    error |= clSetKernelArg(p.classifyContactsKernel, 3, sizeof(int), &gridWidth);
+    error |= clSetKernelArg(p.classifyContactsKernel, 4, sizeof(int), &gridHeight);
+    error |= clSetKernelArg(p.classifyContactsKernel, 5, sizeof(int), &contactSearchCells);
+    error |= clSetKernelArg(p.classifyContactsKernel, 6, sizeof(cl_mem), &p.cellCountBuffer);
+    error |= clSetKernelArg(p.classifyContactsKernel, 7, sizeof(cl_mem), &p.contactFlagsBuffer);
+    checkError(error, "setting contact classification kernel arguments");
+    
+    enqueueKernel(p, p.classifyContactsKernel, globalSize, nullptr,
+                  "enqueueing contact classification kernel");
+    compactActiveList(p, p.contactFlagsBuffer, p.contactListBuffer, ACTIVE_CONTACT);
+
+    if (config.solver == SolverMode::Coloured) {
+        buildCellLists(p);
+        buildContactList(p, deltaTime);
+        colourContacts(p);
+        solveColouredContacts(p);
+    } else if (config.solver == SolverMode::Jacobi) {
+        buildCellLists(p);
+        buildContactList(p, deltaTime);
+        solveJacobiContacts(p);
+    } else {
+        // Simulate CPU work: Process ball collisions between candidates
+        // On M1, this runs on same processor but simulates CPU task parallelism
+        error = clSetKernelArg(p.cpuKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+        error |= clSetKernelArg(p.cpuKernel, 1, sizeof(cl_mem), &p.contactListBuffer);
+        error |= clSetKernelArg(p.cpuKernel, 2, sizeof(cl_mem), &p.activeCountBuffer);
+        error |= clSetKernelArg(p.cpuKernel, 3, sizeof(cl_mem), &p.statsBuffer);
+        checkError(error, "setting CPU kernel arguments");
+        
+        activeSize = activeDispatchSize(p, ACTIVE_CONTACT);
+        enqueueKernel(p, p.cpuKernel, activeSize, nullptr, "enqueueing CPU kernel");
+    }
+
+    // Size the next frame's list-driven launches without stalling this one
+    requestActiveCounts(p);
+}
+
+void simulateFrame(float deltaTime) {
+    simulatePipelineFrame(mainPipeline, config.numBalls, deltaTime);
+}
+
+std::vector<KernelInterval> takeKernelIntervals() {
+    SimulationPipeline& p = *mainPipeline;
+    std::vector<KernelInterval> intervals;
+    for (KernelLaunch& launch : p.kernelLaunches) {
+        KernelInterval interval;
+        interval.name = p.kernelNames.at(launch.kernel);
+        interval.hostQueued = launch.hostQueued;
+        clWaitForEvents(1, &launch.event);
+        cl_int error = clGetEventProfilingInfo(launch.event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong),
+                                               &interval.queued, nullptr);
+        error |= clGetEventProfilingInfo(launch.event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong),
+                                         &interval.start, nullptr);
+        error |= clGetEventProfilingInfo(launch.event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong),
+                                         &interval.end, nullptr);
+        checkError(error, "reading kernel profiling info");
+        intervals.push_back(interval);
+    }
+    releaseKernelEvents(p);
+    return intervals;
+}
+
+size_t simulationDeviceBytes() {
+    return pipelineDeviceBytes(mainPipeline);
+}
+
+bool glSharingEnabled() {
+    return glSharing;
+}
+
+void shareVertexBuffer(cl_uint glBuffer) {
+    cl_int error;
+    cl_mem sharedBuffer = clCreateFromGLBuffer(context, CL_MEM_WRITE_ONLY, glBuffer, &error);
+    checkError(error, "sharing vertex buffer with OpenGL");
+    clReleaseMemObject(mainPipeline->vertexBuffer);
+    mainPipeline->vertexBuffer = sharedBuffer;
+    vertexBuffer = sharedBuffer;
+    vertexBufferShared = true;
+}
+
+void enqueueVertexUpdate() {
+    SimulationPipeline& p = *mainPipeline;
+    int numBalls = config.numBalls;
+    cl_int error = clSetKernelArg(p.vertexKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.vertexKernel, 1, sizeof(cl_mem), &p.vertexBuffer);
+    error |= clSetKernelArg(p.vertexKernel, 2, sizeof(int), &numBalls);
+    checkError(error, "setting vertex kernel arguments");
+
+    // GL finished drawing from the buffer before the last swap, and the
+    // frame's clFinish completes the release before GL draws again
+    if (vertexBufferShared) {
+        error = clEnqueueAcquireGLObjects(p.queue, 1, &p.vertexBuffer, 0, nullptr, nullptr);
+        checkError(error, "acquiring vertex buffer from OpenGL");
+    }
+    size_t globalSize = numBalls;
+    enqueueKernel(p, p.vertexKernel, globalSize, nullptr, "enqueueing vertex kernel");
+    if (vertexBufferShared) {
+        error = clEnqueueReleaseGLObjects(p.queue, 1, &p.vertexBuffer, 0, nullptr, nullptr);
+        checkError(error, "releasing vertex buffer to OpenGL");
+    }
+}
+
+void readLodView(int width, int height, float minDiameter, std::vector<cl_int>& density,
+                 std::vector<cl_float4>& discs) {
+    SimulationPipeline& p = *mainPipeline;
+    cl_int error;
+    if (densityPixels != width * height) {
+        if (densityBuffer) clReleaseMemObject(densityBuffer);
+        densityPixels = width * height;
+        densityBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int) * densityPixels, nullptr, &error);
+        checkError(error, "creating density buffer");
+    }
+    if (!discCountBuffer) {
+        discCountBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), nullptr, &error);
+        checkError(error, "creating disc count buffer");
+    }
+
+    cl_int zero = 0;
+    error = clEnqueueFillBuffer(p.queue, densityBuffer, &zero, sizeof(cl_int), 0, sizeof(cl_int) * densityPixels,
+                                0, nullptr, nullptr);
+    error |= clEnqueueFillBuffer(p.queue, discCountBuffer, &zero, sizeof(cl_int), 0, sizeof(cl_int),
+                                 0, nullptr, nullptr);
+    checkError(error, "clearing density image");
+
+    // The disc list reuses vertexBuffer, which holds a float4 per ball
+    int numBalls = config.numBalls;
+    FLOAT2 pixelScale = {width / config.worldWidth, height / config.worldHeight};
+    error = clSetKernelArg(p.splatKernel, 0, sizeof(cl_mem), &p.ballBuffer);
+    error |= clSetKernelArg(p.splatKernel, 1, sizeof(int), &numBalls);
+    error |= clSetKernelArg(p.splatKernel, 2, sizeof(FLOAT2), &pixelScale);
+    error |= clSetKernelArg(p.splatKernel, 3, sizeof(float), &minDiameter);
+    error |= clSetKernelArg(p.splatKernel, 4, sizeof(int), &width);
+    error |= clSetKernelArg(p.splatKernel, 5, sizeof(int), &height);
+    error |= clSetKernelArg(p.splatKernel, 6, sizeof(cl_mem), &densityBuffer);
+    error |= clSetKernelArg(p.splatKernel, 7, sizeof(cl_mem), &p.vertexBuffer);
+    error |= clSetKernelArg(p.splatKernel, 8, sizeof(cl_mem), &discCountBuffer);
+    checkError(error, "setting splat kernel arguments");
+    size_t globalSize = numBalls;
+    enqueueKernel(p, p.splatKernel, globalSize, nullptr, "enqueueing splat kernel");
+
+    // Only the image and the discs come back, never the whole ball array
+    cl_int discCount = 0;
+    density.resize(densityPixels);
+    error = clEnqueueReadBuffer(p.queue, densityBuffer, CL_FALSE, 0, sizeof(cl_int) * densityPixels,
+                                density.data(), 0, nullptr, nullptr);
+    error |= clEnqueueReadBuffer(p.queue, discCountBuffer, CL_TRUE, 0, sizeof(cl_int), &discCount,
+                                 0, nullptr, nullptr);
+    checkError(error, "reading density image");
+    discs.resize(discCount);
+    if (discCount > 0) {
+        error = clEnqueueReadBuffer(p.queue, p.vertexBuffer, CL_TRUE, 0, sizeof(cl_float4) * discCount,
+                                    discs.data(), 0, nullptr, nullptr);
+        checkError(error, "reading disc list");
+    }
+}
+
+void readActiveListSizes(int counts[ACTIVE_LIST_COUNT]) {
+    std::copy(mainPipeline->dispatchCounts, mainPipeline->dispatchCounts + ACTIVE_LIST_COUNT, counts);
+}
+
+void cleanupOpenCL() {
+    if (densityBuffer) {
+        clReleaseMemObject(densityBuffer);
+        clReleaseMemObject(discCountBuffer);
+        densityBuffer = discCountBuffer = nullptr;
+        densityPixels = 0;
+    }
+    releasePipeline(mainPipeline);
+    mainPipeline = nullptr;
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+}
@@ -0,0 +1,128 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <string>
+#include <vector>
+#include "ball_def.h"
+
+// Global Constants for Simulation
+const int WINDOW_WIDTH = 800;
+const int WINDOW_HEIGHT = 600;
+const float MIN_RADIUS = 15.0f;    
+const float MAX_RADIUS = 25.0f;   
+const float MAX_INITIAL_VELOCITY = 500.0f;
+
+// Broad-phase grid: cells at least one max diameter wide so touching
+// balls always sit in neighbouring cells
+const float CELL_SIZE = 2.0f * MAX_RADIUS;
+
+// Work-group size of the prefix-sum kernels (each group scans 2x this)
+const size_t SCAN_GROUP_SIZE = 128;
+
+// Contact list capacity; each pair is shared by two balls, so this leaves
+// headroom over the six-neighbour limit of equal discs
+const int MAX_CONTACTS_PER_BALL = 4;
+
+// OpenCL Core Components
+// Note: On M1, these components simulate CPU/GPU separation
+// though they run on the unified processor
+extern cl_platform_id platform;
+extern cl_device_id device;
+extern cl_context context;
+extern cl_command_queue queue;
+extern cl_mem ballBuffer, vertexBuffer, statsBuffer;
+
+// Broad-phase grid size derived from the configuration
+extern int gridWidth, gridHeight;
+
+// Kernels and buffers of the simulation on one device (simulation.cpp)
+// initOpenCL sets up one for the main device; decomposed runs add more
+struct SimulationPipeline;
+
+// Reads kernel source file into string
+std::string readFile(const std::string& filename);
+
+// Handles OpenCL errors with descriptive messages
+void checkError(cl_int error, const char* operation);
+
+// Sets up OpenCL environment, kernels and simulation buffers for up to
+// capacity balls in ballBuffer
+// glProperties name a current GL context to share buffers with; the context
+// is created without sharing if they are empty or the device lacks
+// cl_khr_gl_sharing (or cl_APPLE_gl_sharing)
+void initOpenCL(int capacity, const std::vector<cl_context_properties>& glProperties = {});
+
+// Whether initOpenCL created the context shared with OpenGL
+bool glSharingEnabled();
+
+// Replaces vertexBuffer with an OpenCL view of a GL buffer of float4 per ball
+// Needs glSharingEnabled
+void shareVertexBuffer(cl_uint glBuffer);
+
+// Enqueues packing of ballBuffer into vertexBuffer as (x, y, radius, 0) per
+// ball, acquiring and releasing it around the kernel when it is shared
+void enqueueVertexUpdate();
+
+// Enqueues generation of random, non-overlapping balls straight into
+// ballBuffer; the balls depend only on the seed, not on the launch size
+void generateBallsOnDevice(cl_ulong seed);
+
+// Enqueues one simulation step: active-list builds, integration, walls and collisions
+void simulateFrame(float deltaTime);
+
+// Device memory held by the main pipeline's buffers, in bytes
+size_t simulationDeviceBytes();
+
+// Level-of-detail view of ballBuffer for drawing very many balls: counts the
+// balls narrower than minDiameter screen pixels per pixel of a width x height
+// image of the world, and lists the others as (x, y, radius, colour index)
+// discs. Reads back only the image and the discs; vertexBuffer holds the
+// discs, so it must not be shared
+void readLodView(int width, int height, float minDiameter, std::vector<cl_int>& density,
+                 std::vector<cl_float4>& discs);
+
+// Main pipeline active list sizes (ACTIVE_MOVING ...) from the last readback
+// that finished, which lags the current frame by a frame or two
+void readActiveListSizes(int counts[ACTIVE_LIST_COUNT]);
+
+// Device timestamps of one kernel launch, in nanoseconds
+struct KernelInterval {
+    std::string name;    // Kernel function name
+    cl_ulong queued, start, end;
+    cl_ulong hostQueued;  // Host steady clock when the launch was enqueued
+};
+
+// Waits for the main pipeline's kernel launches since the last call and
+// returns their device intervals in launch order
+// Launches are only recorded when config.profileKernels was set for initOpenCL
+std::vector<KernelInterval> takeKernelIntervals();
+
+// Builds the kernels on a device and allocates buffers for capacity balls
+// Needs initOpenCL to have sized the broad-phase grid
+SimulationPipeline* createPipeline(cl_context pipelineContext, cl_device_id pipelineDevice,
+                                   cl_command_queue pipelineQueue, int capacity);
+
+// Grows the pipeline buffers to hold numBalls; reallocates the ball buffer,
+// so call it before writing the balls of a frame
+void reservePipelineBalls(SimulationPipeline* pipeline, int numBalls);
+
+cl_mem pipelineBallBuffer(SimulationPipeline* pipeline);
+
+// Enqueues one simulation step over the first numBalls balls of the pipeline
+void simulatePipelineFrame(SimulationPipeline* pipeline, int numBalls, float deltaTime);
+
+// Device memory held by the pipeline's buffers, in bytes
+size_t pipelineDeviceBytes(SimulationPipeline* pipeline);
+
+// Releases the pipeline's kernels and buffers, but not its context or queue
+void releasePipeline(SimulationPipeline* pipeline);
+
+// Releases OpenCL resources
+void cleanupOpenCL();
+
+#endif // SIMULATION_H
@@ -0,0 +1,101 @@
+// Initial placement: at several packing fractions, every ball lies inside the
+// world and no two balls overlap
+
+#include "placement.h"
+#include "sim_config.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// Checks bounds and every pair of balls closer than two maximum radii, found
+// through a grid one maximum diameter wide
+void checkPlacement(const std::string& name, const std::vector<Ball>& balls) {
+    expect(static_cast<int>(balls.size()) == config.numBalls, name + ": ball count");
+
+    int outside = 0;
+    std::unordered_map<long long, std::vector<int>> grid;
+    for (int i = 0; i < static_cast<int>(balls.size()); i++) {
+        const Ball& ball = balls[i];
+        if (ball.position.x - ball.radius < 0.0f || ball.position.x + ball.radius > config.worldWidth ||
+            ball.position.y - ball.radius < 0.0f || ball.position.y + ball.radius > config.worldHeight ||
+            ball.radius < MIN_RADIUS || ball.radius > MAX_RADIUS) {
+            outside++;
+        }
+        long long cellX = static_cast<long long>(std::floor(ball.position.x / PLACEMENT_CELL));
+        long long cellY = static_cast<long long>(std::floor(ball.position.y / PLACEMENT_CELL));
+        grid[cellY * 1000003 + cellX].push_back(i);
+    }
+    expect(outside == 0, name + ": " + std::to_string(outside) + " balls outside the world");
+
+    int overlaps = 0;
+    for (int i = 0; i < static_cast<int>(balls.size()); i++) {
+        const Ball& ball = balls[i];
+        long long cellX = static_cast<long long>(std::floor(ball.position.x / PLACEMENT_CELL));
+        long long cellY = static_cast<long long>(std::floor(ball.position.y / PLACEMENT_CELL));
+        for (long long y = cellY - 1; y <= cellY + 1; y++) {
+            for (long long x = cellX - 1; x <= cellX + 1; x++) {
+                auto found = grid.find(y * 1000003 + x);
+                if (found == grid.end()) continue;
+                for (int j : found->second) {
+                    if (j <= i) continue;
+                    float dx = balls[j].position.x - ball.position.x;
+                    float dy = balls[j].position.y - ball.position.y;
+                    float reach = ball.radius + balls[j].radius;
+                    if (dx * dx + dy * dy < reach * reach) overlaps++;
+                }
+            }
+        }
+    }
+    expect(overlaps == 0, name + ": " + std::to_string(overlaps) + " overlapping pairs");
+}
+
+}  // namespace
+
+int main() {
+    // Sparse and dense cell selection, one and several RNG blocks
+    for (int numBalls : {1, 1000, 50000}) {
+        for (float packing : {0.05f, 0.3f, 0.5f}) {
+            config.numBalls = numBalls;
+            config.worldWidth = 800.0f;
+            config.worldHeight = 600.0f;
+            config.packingFraction = packing;
+            applyPackingFraction();
+
+            std::mt19937 rng(numBalls);
+            std::vector<Ball> balls;
+            placeBalls(balls, rng);
+            checkPlacement(std::to_string(numBalls) + " balls at packing " + std::to_string(packing), balls);
+        }
+    }
+
+    // Every placement cell taken, in the configured world
+    config.packingFraction = 0.0f;
+    config.worldWidth = 16 * PLACEMENT_CELL;
+    config.worldHeight = 12 * PLACEMENT_CELL;
+    config.numBalls = 16 * 12;
+    std::mt19937 rng(7);
+    std::vector<Ball> balls;
+    placeBalls(balls, rng);
+    checkPlacement("full grid", balls);
+
+    if (failures > 0) {
+        std::cerr << failures << " placement checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Placement checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Round trips of the trajectory codec: keyframes, delta frames, ball counts
+// around the packing block size and positions at and past the world edges
+
+#include "trajectory_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// Encodes frames with one codec and decodes them with another, checking every
+// coordinate lands within half a quantization step of its clamped value
+void checkRoundTrip(const std::string& name, int numBalls, float precision, float worldWidth, float worldHeight,
+                    const std::vector<std::vector<float>>& frames, int keyframeInterval) {
+    TrajectoryCodec encoder, decoder;
+    initTrajectoryCodec(encoder, numBalls, precision, worldWidth, worldHeight);
+    initTrajectoryCodec(decoder, numBalls, precision, worldWidth, worldHeight);
+    float maxX = encoder.maxX * precision;
+    float maxY = encoder.maxY * precision;
+
+    std::vector<float> decoded(2 * numBalls);
+    for (size_t f = 0; f < frames.size(); f++) {
+        bool keyframe = f % keyframeInterval == 0;
+        std::vector<char> data;
+        encodeTrajectoryFrame(encoder, frames[f].data(), keyframe, data);
+        bool ok = decodeTrajectoryFrame(decoder, data.data(), data.size(), keyframe, decoded.data());
+        expect(ok, name + ": frame " + std::to_string(f) + " decodes");
+        if (!ok) return;
+
+        int wrong = 0;
+        for (int i = 0; i < 2 * numBalls; i++) {
+            float expected = std::clamp(frames[f][i], 0.0f, i % 2 ? maxY : maxX);
+            float tolerance = 0.5f * precision + 1e-6f * std::fabs(expected);
+            if (!(std::fabs(decoded[i] - expected) <= tolerance)) wrong++;
+        }
+        expect(wrong == 0, name + ": frame " + std::to_string(f) + " has " + std::to_string(wrong) +
+                               " coordinates off by more than half a step");
+
+        // A truncated frame must be rejected, not read past its end
+        if (!data.empty()) {
+            TrajectoryCodec truncated = decoder;
+            std::vector<float> scratch(2 * numBalls);
+            expect(!decodeTrajectoryFrame(truncated, data.data(), data.size() - 1, keyframe, scratch.data()),
+                   name + ": truncated frame " + std::to_string(f) + " is rejected");
+        }
+    }
+}
+
+// Random walk over the world, starting from uniform positions
+std::vector<std::vector<float>> randomWalk(int numBalls, int frameCount, float worldWidth, float worldHeight,
+                                           float step, std::mt19937& rng) {
+    std::uniform_real_distribution<float> xDist(0.0f, worldWidth), yDist(0.0f, worldHeight);
+    std::uniform_real_distribution<float> stepDist(-step, step);
+    std::vector<std::vector<float>> frames(frameCount, std::vector<float>(2 * numBalls));
+    for (int i = 0; i < numBalls; i++) {
+        frames[0][2 * i] = xDist(rng);
+        frames[0][2 * i + 1] = yDist(rng);
+    }
+    for (int f = 1; f < frameCount; f++) {
+        for (int i = 0; i < numBalls; i++) {
+            frames[f][2 * i] = std::clamp(frames[f - 1][2 * i] + stepDist(rng), 0.0f, worldWidth);
+            frames[f][2 * i + 1] = std::clamp(frames[f - 1][2 * i + 1] + stepDist(rng), 0.0f, worldHeight);
+        }
+    }
+    return frames;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 rng(1);
+
+    // Value counts 2, 254, 256, 258 and 600 around the 256-value block
+    for (int numBalls : {1, 127, 128, 129, 300}) {
+        std::string name = std::to_string(numBalls) + " balls";
+        checkRoundTrip(name, numBalls, 0.01f, 800.0f, 600.0f, randomWalk(numBalls, 20, 800.0f, 600.0f, 3.0f, rng), 8);
+    }
+
+    // Edges of the world, positions outside it and jumps across the whole
+    // world between frames, which give the widest deltas
+    std::vector<std::vector<float>> edges = {
+        {0.0f, 0.0f, 800.0f, 600.0f, -5.0f, 700.0f, 900.0f, -1.0f, 400.0f, 300.0f},
+        {800.0f, 600.0f, 0.0f, 0.0f, 900.0f, -1.0f, -5.0f, 700.0f, 400.0f, 300.0f},
+        {0.004f, 599.996f, 799.996f, 0.004f, 400.0f, 300.0f, 0.0f, 600.0f, 800.0f, 0.0f},
+    };
+    checkRoundTrip("world edges", 5, 0.01f, 800.0f, 600.0f, edges, 64);
+    {
+        TrajectoryCodec encoder, decoder;
+        initTrajectoryCodec(encoder, 1, 0.01f, 800.0f, 600.0f);
+        initTrajectoryCodec(decoder, 1, 0.01f, 800.0f, 600.0f);
+        float nan[2] = {NAN, NAN}, decoded[2] = {1.0f, 1.0f};
+        std::vector<char> data;
+        encodeTrajectoryFrame(encoder, nan, true, data);
+        expect(decodeTrajectoryFrame(decoder, data.data(), data.size(), true, decoded) &&
+               decoded[0] == 0.0f && decoded[1] == 0.0f, "NaN positions decode as 0");
+    }
+
+    // The finest precision the recorder accepts for a large world: full-span
+    // deltas need nearly all 31 bits
+    float hugeWorld = 1.0e6f;
+    float finePrecision = hugeWorld / (1 << 30);
+    std::vector<std::vector<float>> spans = {
+        {0.0f, 0.0f}, {hugeWorld, hugeWorld}, {0.0f, hugeWorld}, {hugeWorld, 0.0f}
+    };
+    checkRoundTrip("full-span deltas", 1, finePrecision, hugeWorld, hugeWorld, spans, 64);
+
+    // Decoding may start at any keyframe with a fresh codec
+    {
+        std::vector<std::vector<float>> frames = randomWalk(200, 12, 800.0f, 600.0f, 2.0f, rng);
+        TrajectoryCodec encoder;
+        initTrajectoryCodec(encoder, 200, 0.05f, 800.0f, 600.0f);
+        std::vector<std::vector<char>> encoded(frames.size());
+        for (size_t f = 0; f < frames.size(); f++) {
+            encodeTrajectoryFrame(encoder, frames[f].data(), f % 4 == 0, encoded[f]);
+        }
+        TrajectoryCodec decoder;
+        initTrajectoryCodec(decoder, 200, 0.05f, 800.0f, 600.0f);
+        std::vector<float> decoded(400);
+        bool ok = true;
+        for (size_t f = 4; f < frames.size(); f++) {
+            ok = ok && decodeTrajectoryFrame(decoder, encoded[f].data(), encoded[f].size(), f % 4 == 0,
+                                             decoded.data());
+        }
+        float worst = 0.0f;
+        for (int i = 0; i < 400; i++) worst = std::max(worst, std::fabs(decoded[i] - frames.back()[i]));
+        expect(ok && worst <= 0.025f + 1e-4f, "decoding from a later keyframe");
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " trajectory codec checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Trajectory codec round trips passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,112 @@
+// TripleBuffer hand-off: the reader always gets the latest complete snapshot
+// and never a slot the writer is filling
+
+#include "triple_buffer.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+const int SNAPSHOT_VALUES = 256;
+
+// Every value holds the sequence number once the writer completes it
+struct Snapshot {
+    std::atomic<bool> writing{false};  // Set while the writer fills the slot
+    long long sequence = 0;
+    long long values[SNAPSHOT_VALUES] = {};
+};
+
+// Single-threaded index swapping: publishes replace each other, and a taken
+// value stays in front until a newer one is published
+void checkSwapping() {
+    TripleBuffer<Snapshot> buffer;
+    expect(!buffer.unread() && !buffer.acquire(), "nothing to take before the first publish");
+
+    buffer.back().sequence = 1;
+    buffer.publish();
+    buffer.back().sequence = 2;
+    buffer.publish();
+    expect(buffer.unread(), "a published value is unread");
+    expect(buffer.acquire() && buffer.front().sequence == 2, "acquire takes the latest of two publishes");
+    expect(!buffer.unread() && !buffer.acquire(), "a taken value is not taken again");
+    expect(buffer.front().sequence == 2, "front keeps the taken value");
+
+    buffer.back().sequence = 3;
+    expect(buffer.front().sequence == 2, "the writer's slot is not the reader's");
+    buffer.publish();
+    expect(buffer.acquire() && buffer.front().sequence == 3, "acquire takes a later publish");
+}
+
+// One writer publishing as fast as it can while one reader takes snapshots
+void checkConcurrentHandOff() {
+    const long long snapshots = 200000;
+    TripleBuffer<Snapshot> buffer;
+    std::atomic<long long> published{0};  // Last sequence whose publish returned
+    std::atomic<bool> finished{false};
+
+    std::thread writer([&] {
+        for (long long sequence = 1; sequence <= snapshots; sequence++) {
+            Snapshot& slot = buffer.back();
+            slot.writing = true;
+            slot.sequence = sequence;
+            for (long long& value : slot.values) value = sequence;
+            slot.writing = false;
+            buffer.publish();
+            published = sequence;
+        }
+        finished = true;
+    });
+
+    long long last = 0;
+    int torn = 0, held = 0, stale = 0;
+    while (true) {
+        bool writerDone = finished;
+        long long before = published;
+        if (!buffer.acquire()) {
+            if (writerDone) break;  // Nothing published after the writer stopped
+            continue;
+        }
+        const Snapshot& slot = buffer.front();
+        if (slot.writing) held++;
+        for (long long value : slot.values) {
+            if (value != slot.sequence) {
+                torn++;
+                break;
+            }
+        }
+        if (slot.writing) held++;
+        if (slot.sequence < before || slot.sequence <= last) stale++;
+        last = slot.sequence;
+    }
+    writer.join();
+
+    expect(held == 0, std::to_string(held) + " snapshots taken while the writer held them");
+    expect(torn == 0, std::to_string(torn) + " torn snapshots");
+    expect(stale == 0, std::to_string(stale) + " snapshots older than one already published");
+    expect(last == snapshots, "the reader ends on the final snapshot");
+}
+
+}  // namespace
+
+int main() {
+    checkSwapping();
+    checkConcurrentHandOff();
+
+    if (failures > 0) {
+        std::cerr << failures << " triple buffer checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Triple buffer checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Trace process ids: host threads and the OpenCL device get separate groups
+const int HOST_PROCESS = 1;
+const int DEVICE_PROCESS = 2;
+
+std::mutex traceMutex;
+std::ofstream traceFile;
+bool traceOpen = false;
+bool firstEvent = true;
+long long traceStart = 0;            // Host nanoseconds at startTrace
+std::map<std::thread::id, int> threadIds;
+
+// Host minus device clock, estimated from launch enqueue times; a launch is
+// queued on the device no earlier than the host call, so the smallest
+// difference is the closest estimate
+long long deviceClockOffset = std::numeric_limits<long long>::max();
+
+long long hostNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Writes one event object; caller holds traceMutex
+void writeEvent(const std::string& event) {
+    traceFile << (firstEvent ? "\n" : ",\n") << event;
+    firstEvent = false;
+}
+
+// Names a process or thread track; caller holds traceMutex
+void writeName(const char* kind, int process, int thread, const std::string& name) {
+    writeEvent(std::string("{\"name\": \"") + kind + "\", \"ph\": \"M\", \"pid\": " + std::to_string(process) +
+               ", \"tid\": " + std::to_string(thread) + ", \"args\": {\"name\": \"" + name + "\"}}");
+}
+
+// Small stable id of the calling thread; caller holds traceMutex
+int currentThreadId() {
+    auto found = threadIds.find(std::this_thread::get_id());
+    if (found != threadIds.end()) return found->second;
+    int id = static_cast<int>(threadIds.size()) + 1;
+    threadIds[std::this_thread::get_id()] = id;
+    return id;
+}
+
+// Complete event with microsecond timestamps relative to the trace start;
+// caller holds traceMutex
+void writeSpan(const std::string& name, int process, int thread, long long start, long long end) {
+    char times[96];
+    snprintf(times, sizeof(times), "\"ts\": %.3f, \"dur\": %.3f", (start - traceStart) * 1.0e-3,
+             std::max(0LL, end - start) * 1.0e-3);
+    writeEvent("{\"name\": \"" + name + "\", \"ph\": \"X\", \"pid\": " + std::to_string(process) +
+               ", \"tid\": " + std::to_string(thread) + ", " + times + "}");
+}
+
+}  // namespace
+
+void startTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceFile.open(path, std::ios::trunc);
+    if (!traceFile) {
+        std::cerr << "Failed to open trace file: " << path << std::endl;
+        exit(1);
+    }
+    traceFile << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    traceOpen = true;
+    firstEvent = true;
+    traceStart = hostNanoseconds();
+    threadIds.clear();
+    deviceClockOffset = std::numeric_limits<long long>::max();
+
+    writeName("process_name", HOST_PROCESS, 0, "Host");
+    writeName("process_name", DEVICE_PROCESS, 0, "OpenCL device");
+    writeName("thread_name", DEVICE_PROCESS, 1, "Kernels");
+    writeName("thread_name", HOST_PROCESS, currentThreadId(), "Main");
+}
+
+void stopTrace() {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceOpen) return;
+    traceFile << "\n]}\n";
+    traceFile.close();
+    traceOpen = false;
+    if (!traceFile) {
+        std::cerr << "Failed to write trace file" << std::endl;
+    }
+}
+
+bool tracing() {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    return traceOpen;
+}
+
+void nameTraceThread(const char* name) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceOpen) return;
+    writeName("thread_name", HOST_PROCESS, currentThreadId(), name);
+}
+
+TraceSpan::TraceSpan(const char* spanName) : name(spanName), start(-1) {
+    if (tracing()) {
+        start = hostNanoseconds();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (start < 0) return;
+    long long end = hostNanoseconds();
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceOpen) return;
+    writeSpan(name, HOST_PROCESS, currentThreadId(), start, end);
+}
+
+void traceKernelIntervals(const std::vector<KernelInterval>& intervals) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceOpen) return;
+    for (const KernelInterval& interval : intervals) {
+        deviceClockOffset = std::min(deviceClockOffset, static_cast<long long>(interval.hostQueued) -
+                                                        static_cast<long long>(interval.queued));
+    }
+    for (const KernelInterval& interval : intervals) {
+        writeSpan(interval.name, DEVICE_PROCESS, 1, static_cast<long long>(interval.start) + deviceClockOffset,
+                  static_cast<long long>(interval.end) + deviceClockOffset);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include "simulation.h"
+
+// Timeline tracing as Chrome trace-event JSON, viewable in chrome://tracing
+// or ui.perfetto.dev
+// Host spans are recorded per thread on the host steady clock. Device kernel
+// intervals come from profiled launches (takeKernelIntervals) and are shifted
+// onto the host clock, so host and device work line up on one timeline.
+// Events are streamed to the file as they are recorded
+
+// Opens the trace file; spans and intervals are dropped until this is called
+void startTrace(const std::string& path);
+
+// Closes the event list and the file
+void stopTrace();
+
+bool tracing();
+
+// Names the calling thread's track
+void nameTraceThread(const char* name);
+
+// Host span covering the lifetime of the object
+struct TraceSpan {
+    explicit TraceSpan(const char* spanName);
+    ~TraceSpan();
+
+    const char* name;
+    long long start;  // Host nanoseconds, or -1 when not tracing
+};
+
+// Adds device kernel intervals to the device track
+void traceKernelIntervals(const std::vector<KernelInterval>& intervals);
+
+#endif // TRACE_H
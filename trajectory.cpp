@@ -0,0 +1,337 @@
+#include "trajectory.h"
+#include "trajectory_codec.h"
+#include "simulation.h"
+#include "sim_config.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Staging buffers in flight between the device and the readback thread
+const int TRAJECTORY_STAGING_BUFFERS = 4;
+
+// Frames read back but not yet encoded; beyond this the readback thread
+// holds on to staging buffers and new frames are dropped
+const size_t MAX_PENDING_FRAMES = 8;
+
+// Recorded frames per chunk written to disk
+const uint32_t TRAJECTORY_FRAMES_PER_CHUNK = 16;
+
+// Recorded frames between keyframes of the quantized encoding
+const uint32_t TRAJECTORY_KEYFRAME_INTERVAL = 64;
+
+// Host-allocated staging buffer; mapping it gives a pinned host pointer
+struct StagingSlot {
+    cl_mem buffer;
+    Ball* mapped;
+    cl_event mapEvent;
+    long long frame;
+    double simulationTime;
+    bool busy;
+};
+
+// Positions copied out of a staging buffer, waiting for the encoder
+struct PendingFrame {
+    long long frame;
+    double simulationTime;
+    std::vector<float> positions;  // x,y per ball
+};
+
+StagingSlot slots[TRAJECTORY_STAGING_BUFFERS];
+std::deque<int> filledSlots;  // Slots waiting for readback, in frame order
+std::deque<PendingFrame> pendingFrames;
+std::thread readbackThread, encoderThread;
+std::mutex recorderMutex;
+std::condition_variable recorderWake;
+bool readbackStopping = false;
+bool encoderStopping = false;
+bool recording = false;
+long long droppedFrames = 0;
+
+// Encoder thread state
+std::ofstream trajectoryFile;
+uint64_t fileOffset = 0;
+std::vector<char> chunk;      // Frame records of the chunk being assembled
+uint32_t chunkFrames = 0;
+std::vector<TrajectoryIndexEntry> frameIndex;
+uint32_t encoding;
+TrajectoryCodec codec;
+std::vector<char> encoded;
+double encodeSeconds = 0.0;
+uint64_t rawBytes = 0;        // Positions as floats, before encoding
+uint64_t encodedBytes = 0;
+
+void writeBytes(const void* data, size_t size) {
+    trajectoryFile.write(static_cast<const char*>(data), size);
+    fileOffset += size;
+}
+
+void appendBytes(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    chunk.insert(chunk.end(), bytes, bytes + size);
+}
+
+// Writes the assembled chunk behind its header
+void flushChunk() {
+    if (chunkFrames == 0) return;
+    TrajectoryChunkHeader header = {TRAJECTORY_CHUNK_MAGIC, chunkFrames, chunk.size()};
+    writeBytes(&header, sizeof(header));
+    writeBytes(chunk.data(), chunk.size());
+    trajectoryFile.flush();
+    chunk.clear();
+    chunkFrames = 0;
+}
+
+// Encodes one frame and appends it to the current chunk
+void appendFrame(const PendingFrame& frame) {
+    auto start = std::chrono::high_resolution_clock::now();
+    uint32_t flags = TRAJECTORY_KEYFRAME;
+    encoded.clear();
+    if (encoding == TRAJECTORY_QUANTIZED) {
+        bool keyframe = frameIndex.size() % TRAJECTORY_KEYFRAME_INTERVAL == 0;
+        encodeTrajectoryFrame(codec, frame.positions.data(), keyframe, encoded);
+        flags = keyframe ? TRAJECTORY_KEYFRAME : 0;
+    } else {
+        const char* bytes = reinterpret_cast<const char*>(frame.positions.data());
+        encoded.assign(bytes, bytes + sizeof(float) * frame.positions.size());
+    }
+    encodeSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    rawBytes += sizeof(float) * frame.positions.size();
+    encodedBytes += encoded.size();
+
+    // Frame offsets are known once the chunk header is in front of them
+    uint64_t offset = fileOffset + sizeof(TrajectoryChunkHeader) + chunk.size();
+    uint32_t byteSize = static_cast<uint32_t>(encoded.size());
+    frameIndex.push_back(TrajectoryIndexEntry{frame.frame, frame.simulationTime, offset, byteSize, flags});
+
+    TrajectoryFrameHeader header = {frame.frame, frame.simulationTime, byteSize, flags};
+    appendBytes(&header, sizeof(header));
+    appendBytes(encoded.data(), encoded.size());
+
+    if (++chunkFrames == TRAJECTORY_FRAMES_PER_CHUNK) {
+        flushChunk();
+    }
+}
+
+// Readback thread: waits for each mapped snapshot, copies the positions out
+// and returns the staging buffer straight away
+void readbackLoop() {
+    nameTraceThread("Trajectory readback");
+    std::unique_lock<std::mutex> lock(recorderMutex);
+    while (true) {
+        recorderWake.wait(lock, [] { return !filledSlots.empty() || readbackStopping; });
+        if (filledSlots.empty()) break;
+
+        // Wait for the encoder to catch up; the simulation keeps running and
+        // drops frames once every staging buffer is held here
+        recorderWake.wait(lock, [] { return pendingFrames.size() < MAX_PENDING_FRAMES; });
+        int index = filledSlots.front();
+        filledSlots.pop_front();
+        lock.unlock();
+
+        StagingSlot& slot = slots[index];
+        PendingFrame frame = {slot.frame, slot.simulationTime, std::vector<float>(2 * config.numBalls)};
+        cl_int error;
+        {
+            TraceSpan span("wait for trajectory snapshot");
+            error = clWaitForEvents(1, &slot.mapEvent);
+        }
+        clReleaseEvent(slot.mapEvent);
+        bool valid = error == CL_SUCCESS;
+        if (valid) {
+            for (int i = 0; i < config.numBalls; i++) {
+                frame.positions[2 * i] = slot.mapped[i].position.x;
+                frame.positions[2 * i + 1] = slot.mapped[i].position.y;
+            }
+        } else {
+            std::cerr << "Trajectory readback failed with error " << error << std::endl;
+        }
+
+        // The in-order queue runs this unmap before the slot's next copy
+        error = clEnqueueUnmapMemObject(queue, slot.buffer, slot.mapped, 0, nullptr, nullptr);
+        checkError(error, "unmapping trajectory staging buffer");
+        clFlush(queue);
+
+        lock.lock();
+        slot.busy = false;
+        if (valid) {
+            pendingFrames.push_back(std::move(frame));
+            recorderWake.notify_all();
+        }
+    }
+}
+
+// Encoder thread: encodes frames in order and writes chunks to disk
+void encoderLoop() {
+    nameTraceThread("Trajectory encoder");
+    std::unique_lock<std::mutex> lock(recorderMutex);
+    while (true) {
+        recorderWake.wait(lock, [] { return !pendingFrames.empty() || encoderStopping; });
+        if (pendingFrames.empty()) break;
+
+        PendingFrame frame = std::move(pendingFrames.front());
+        pendingFrames.pop_front();
+        recorderWake.notify_all();
+        lock.unlock();
+
+        {
+            TraceSpan span("encode trajectory frame");
+            appendFrame(frame);
+        }
+
+        lock.lock();
+    }
+}
+
+}  // namespace
+
+void startTrajectoryRecorder(const std::string& path, int recordInterval, float precision) {
+    // Quantized coordinates and their frame-to-frame deltas must fit in 31
+    // bits; checked here because --packing and --restore set the final world
+    if (precision > 0.0f && std::max(config.worldWidth, config.worldHeight) / precision > (1 << 30)) {
+        std::cerr << "--trajectory-precision " << precision << " is too fine for the " << config.worldWidth
+                  << "x" << config.worldHeight << " world" << std::endl;
+        exit(1);
+    }
+
+    trajectoryFile.open(path, std::ios::binary | std::ios::trunc);
+    if (!trajectoryFile) {
+        std::cerr << "Failed to open trajectory file: " << path << std::endl;
+        exit(1);
+    }
+
+    // Radii never change, so they are stored once in the header
+    std::vector<Ball> balls(config.numBalls);
+    cl_int error = clEnqueueReadBuffer(queue, ballBuffer, CL_TRUE, 0,
+                                       sizeof(Ball) * config.numBalls, balls.data(),
+                                       0, nullptr, nullptr);
+    checkError(error, "reading ball radii for trajectory");
+
+    encoding = precision > 0.0f ? TRAJECTORY_QUANTIZED : TRAJECTORY_RAW;
+    if (encoding == TRAJECTORY_QUANTIZED) {
+        initTrajectoryCodec(codec, config.numBalls, precision, config.worldWidth, config.worldHeight);
+    }
+
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, "BALLTRAJ", sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.numBalls = config.numBalls;
+    header.recordInterval = recordInterval;
+    header.framesPerChunk = TRAJECTORY_FRAMES_PER_CHUNK;
+    header.worldWidth = config.worldWidth;
+    header.worldHeight = config.worldHeight;
+    header.encoding = encoding;
+    header.precision = precision;
+    header.keyframeInterval = encoding == TRAJECTORY_QUANTIZED ? TRAJECTORY_KEYFRAME_INTERVAL : 1;
+    fileOffset = 0;
+    writeBytes(&header, sizeof(header));
+    for (const Ball& ball : balls) {
+        writeBytes(&ball.radius, sizeof(float));
+    }
+
+    for (StagingSlot& slot : slots) {
+        slot.buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                                     sizeof(Ball) * config.numBalls, nullptr, &error);
+        checkError(error, "creating trajectory staging buffer");
+        slot.busy = false;
+    }
+
+    readbackStopping = false;
+    encoderStopping = false;
+    recording = true;
+    readbackThread = std::thread(readbackLoop);
+    encoderThread = std::thread(encoderLoop);
+}
+
+void recordTrajectoryFrame(long long frame, double simulationTime) {
+    if (!recording) return;
+
+    StagingSlot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(recorderMutex);
+        for (StagingSlot& candidate : slots) {
+            if (!candidate.busy) {
+                slot = &candidate;
+                break;
+            }
+        }
+        if (!slot) {
+            droppedFrames++;
+            return;
+        }
+        slot->busy = true;
+    }
+
+    // Device-side copy, then a non-blocking map for the readback thread to wait on
+    cl_int error = clEnqueueCopyBuffer(queue, ballBuffer, slot->buffer, 0, 0,
+                                       sizeof(Ball) * config.numBalls, 0, nullptr, nullptr);
+    checkError(error, "copying balls to trajectory staging buffer");
+    slot->mapped = static_cast<Ball*>(clEnqueueMapBuffer(queue, slot->buffer, CL_FALSE, CL_MAP_READ, 0,
+                                                         sizeof(Ball) * config.numBalls, 0, nullptr,
+                                                         &slot->mapEvent, &error));
+    checkError(error, "mapping trajectory staging buffer");
+    clFlush(queue);
+    slot->frame = frame;
+    slot->simulationTime = simulationTime;
+
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    filledSlots.push_back(static_cast<int>(slot - slots));
+    recorderWake.notify_all();
+}
+
+void stopTrajectoryRecorder() {
+    if (!recording) return;
+    {
+        std::lock_guard<std::mutex> lock(recorderMutex);
+        readbackStopping = true;
+        recorderWake.notify_all();
+    }
+    readbackThread.join();
+    {
+        std::lock_guard<std::mutex> lock(recorderMutex);
+        encoderStopping = true;
+        recorderWake.notify_all();
+    }
+    encoderThread.join();
+    recording = false;
+
+    flushChunk();
+    uint64_t indexOffset = fileOffset;
+    writeBytes(frameIndex.data(), sizeof(TrajectoryIndexEntry) * frameIndex.size());
+    TrajectoryTrailer trailer = {indexOffset, frameIndex.size(), {}};
+    std::memcpy(trailer.magic, "TRAJIDX", 8);
+    writeBytes(&trailer, sizeof(trailer));
+    trajectoryFile.close();
+    if (!trajectoryFile) {
+        std::cerr << "Failed to write trajectory file" << std::endl;
+    }
+
+    clFinish(queue);
+    for (StagingSlot& slot : slots) {
+        clReleaseMemObject(slot.buffer);
+    }
+
+    std::cout << "Recorded " << frameIndex.size() << " trajectory frames";
+    if (droppedFrames > 0) {
+        std::cout << ", dropped " << droppedFrames << " while the writer was behind";
+    }
+    std::cout << std::endl;
+
+    // Ratio against float positions and against the full Ball records
+    if (encoding == TRAJECTORY_QUANTIZED && encodedBytes > 0) {
+        double ballBytes = rawBytes / (2.0 * sizeof(float)) * sizeof(Ball);
+        std::cout << "Trajectory compression: " << double(rawBytes) / encodedBytes
+                  << "x over float positions, " << ballBytes / encodedBytes
+                  << "x over Ball records, encoded at "
+                  << rawBytes / 1.0e6 / std::max(encodeSeconds, 1e-9) << " MB/s" << std::endl;
+    }
+}
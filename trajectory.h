@@ -0,0 +1,80 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstdint>
+#include <string>
+
+// Trajectory files: ball positions every few frames for offline analysis
+// Layout: TrajectoryHeader, float radii[numBalls], then chunks of frames
+// (TrajectoryChunkHeader followed by frameCount records of
+// TrajectoryFrameHeader + byteSize bytes of positions), then the frame index
+// (TrajectoryIndexEntry per frame) and a TrajectoryTrailer at the very end
+// A file without trailer (interrupted run) can still be read chunk by chunk
+// Raw frames hold float x,y per ball; quantized frames are encoded with
+// trajectory_codec.h, and delta frames decode only after their keyframe
+
+const uint32_t TRAJECTORY_VERSION = 2;
+const uint32_t TRAJECTORY_CHUNK_MAGIC = 0x4B4E4843;  // "CHNK"
+
+// Frame encodings
+const uint32_t TRAJECTORY_RAW = 0;
+const uint32_t TRAJECTORY_QUANTIZED = 1;
+
+// Frame flags
+const uint32_t TRAJECTORY_KEYFRAME = 1;
+
+struct TrajectoryHeader {
+    char magic[8];            // "BALLTRAJ"
+    uint32_t version;
+    uint32_t numBalls;
+    uint32_t recordInterval;  // Simulation frames between recorded frames
+    uint32_t framesPerChunk;
+    float worldWidth;
+    float worldHeight;
+    uint32_t encoding;
+    float precision;          // Quantization step in world units
+    uint32_t keyframeInterval;
+    uint32_t padding;
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t magic;
+    uint32_t frameCount;
+    uint64_t byteSize;        // Size of the frame records that follow
+};
+
+struct TrajectoryFrameHeader {
+    int64_t frame;            // Simulation frame number
+    double time;              // Simulation time in seconds
+    uint32_t byteSize;        // Size of the encoded positions that follow
+    uint32_t flags;
+};
+
+struct TrajectoryIndexEntry {
+    int64_t frame;
+    double time;
+    uint64_t offset;          // File offset of the TrajectoryFrameHeader
+    uint32_t byteSize;
+    uint32_t flags;
+};
+
+struct TrajectoryTrailer {
+    uint64_t indexOffset;
+    uint64_t frameCount;
+    char magic[8];            // "TRAJIDX", marks a complete file
+};
+
+// Opens the trajectory file, allocates pinned staging buffers and starts the
+// readback and encoder threads; precision > 0 selects the quantized encoding
+// Reads radii from ballBuffer once, so call after the initial state is uploaded
+void startTrajectoryRecorder(const std::string& path, int recordInterval, float precision);
+
+// Snapshots ballBuffer into a free staging buffer for the writer thread
+// Never blocks; the frame is dropped if every staging buffer is in flight
+void recordTrajectoryFrame(long long frame, double simulationTime);
+
+// Drains pending frames, writes the frame index, releases staging buffers
+// and reports the compression ratio and encode throughput
+void stopTrajectoryRecorder();
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,124 @@
+#include "trajectory_codec.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+int bitWidth(uint32_t value) {
+    int bits = 0;
+    while (value) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+uint32_t quantize(float position, float precision, uint32_t maxValue) {
+    float scaled = std::round(position / precision);
+    if (!(scaled > 0.0f)) return 0;  // Also catches NaN
+    return std::min(static_cast<uint32_t>(std::min(scaled, 4294967040.0f)), maxValue);
+}
+
+// Packs values in blocks, each with the bit width of its largest value
+void packValues(const std::vector<uint32_t>& values, std::vector<char>& out) {
+    for (size_t start = 0; start < values.size(); start += TRAJECTORY_CODEC_BLOCK) {
+        size_t end = std::min(values.size(), start + TRAJECTORY_CODEC_BLOCK);
+        uint32_t combined = 0;
+        for (size_t i = start; i < end; i++) combined |= values[i];
+        int width = bitWidth(combined);
+        out.push_back(static_cast<char>(width));
+
+        uint64_t accumulator = 0;
+        int pending = 0;
+        for (size_t i = start; i < end; i++) {
+            accumulator |= static_cast<uint64_t>(values[i]) << pending;
+            pending += width;
+            while (pending >= 8) {
+                out.push_back(static_cast<char>(accumulator & 0xFF));
+                accumulator >>= 8;
+                pending -= 8;
+            }
+        }
+        if (pending > 0) {
+            out.push_back(static_cast<char>(accumulator & 0xFF));
+        }
+    }
+}
+
+// Inverse of packValues; returns false if the data runs out
+bool unpackValues(const char* data, size_t size, std::vector<uint32_t>& values) {
+    size_t offset = 0;
+    for (size_t start = 0; start < values.size(); start += TRAJECTORY_CODEC_BLOCK) {
+        size_t end = std::min(values.size(), start + TRAJECTORY_CODEC_BLOCK);
+        if (offset >= size) return false;
+        int width = static_cast<unsigned char>(data[offset++]);
+        if (width > 32) return false;
+        size_t bytes = ((end - start) * width + 7) / 8;
+        if (offset + bytes > size) return false;
+
+        uint64_t accumulator = 0;
+        int available = 0;
+        uint64_t mask = width == 32 ? 0xFFFFFFFFull : ((1ull << width) - 1);
+        for (size_t i = start; i < end; i++) {
+            while (available < width) {
+                accumulator |= static_cast<uint64_t>(static_cast<unsigned char>(data[offset++])) << available;
+                available += 8;
+            }
+            values[i] = static_cast<uint32_t>(accumulator & mask);
+            accumulator >>= width;
+            available -= width;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+void initTrajectoryCodec(TrajectoryCodec& codec, int numBalls, float precision,
+                         float worldWidth, float worldHeight) {
+    codec.numBalls = numBalls;
+    codec.precision = precision;
+    codec.maxX = static_cast<uint32_t>(std::ceil(worldWidth / precision));
+    codec.maxY = static_cast<uint32_t>(std::ceil(worldHeight / precision));
+    codec.previous.assign(2 * numBalls, 0);
+}
+
+void encodeTrajectoryFrame(TrajectoryCodec& codec, const float* positions, bool keyframe,
+                           std::vector<char>& out) {
+    std::vector<uint32_t> values(2 * codec.numBalls);
+    for (int i = 0; i < codec.numBalls; i++) {
+        uint32_t x = quantize(positions[2 * i], codec.precision, codec.maxX);
+        uint32_t y = quantize(positions[2 * i + 1], codec.precision, codec.maxY);
+        if (keyframe) {
+            values[2 * i] = x;
+            values[2 * i + 1] = y;
+        } else {
+            values[2 * i] = zigzag(static_cast<int32_t>(x - codec.previous[2 * i]));
+            values[2 * i + 1] = zigzag(static_cast<int32_t>(y - codec.previous[2 * i + 1]));
+        }
+        codec.previous[2 * i] = x;
+        codec.previous[2 * i + 1] = y;
+    }
+    packValues(values, out);
+}
+
+bool decodeTrajectoryFrame(TrajectoryCodec& codec, const char* data, size_t size, bool keyframe,
+                           float* positions) {
+    std::vector<uint32_t> values(2 * codec.numBalls);
+    if (!unpackValues(data, size, values)) return false;
+
+    for (int i = 0; i < 2 * codec.numBalls; i++) {
+        uint32_t value = keyframe ? values[i] : codec.previous[i] + static_cast<uint32_t>(unzigzag(values[i]));
+        codec.previous[i] = value;
+        positions[i] = value * codec.precision;
+    }
+    return true;
+}
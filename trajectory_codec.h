@@ -0,0 +1,38 @@
+#ifndef TRAJECTORY_CODEC_H
+#define TRAJECTORY_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quantized delta codec for trajectory positions
+// Positions are quantized to multiples of the precision inside the world
+// bounds. Keyframes store the quantized values, other frames store the
+// zigzag-encoded difference to the previous frame. Values are bit-packed in
+// blocks of TRAJECTORY_CODEC_BLOCK, each prefixed by its bit width in one byte
+
+const int TRAJECTORY_CODEC_BLOCK = 256;
+
+// Encoder or decoder state: the previous frame's quantized positions
+struct TrajectoryCodec {
+    int numBalls;
+    float precision;
+    uint32_t maxX, maxY;              // Largest quantized coordinate per axis
+    std::vector<uint32_t> previous;   // x,y per ball
+};
+
+// Sets up a codec; precision is in world units
+void initTrajectoryCodec(TrajectoryCodec& codec, int numBalls, float precision,
+                         float worldWidth, float worldHeight);
+
+// Appends one encoded frame of x,y positions to out
+void encodeTrajectoryFrame(TrajectoryCodec& codec, const float* positions, bool keyframe,
+                           std::vector<char>& out);
+
+// Decodes one frame into x,y positions; delta frames need the codec to hold
+// the previous frame, so decoding starts at a keyframe
+// Returns false if the data is truncated
+bool decodeTrajectoryFrame(TrajectoryCodec& codec, const char* data, size_t size, bool keyframe,
+                           float* positions);
+
+#endif // TRAJECTORY_CODEC_H
@@ -0,0 +1,53 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <mutex>
+#include <utility>
+
+// Hands the latest of a stream of values from one writer thread to one
+// reader thread. The writer fills back() and publishes it; the reader takes
+// the latest published value with acquire() and reads front(). Three slots
+// let both work on their own slot at all times, so neither ever waits for
+// the other, and the lock only guards swapping two indices
+template <typename T>
+class TripleBuffer {
+public:
+    // Slot the writer fills next; only the writer may touch it
+    T& back() { return slots[backIndex]; }
+
+    // Makes the back slot the latest value, replacing any the reader has not
+    // taken, and hands the writer the stale slot as its new back slot
+    void publish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(backIndex, readyIndex);
+        fresh = true;
+    }
+
+    // Whether a published value is still waiting for the reader
+    bool unread() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fresh;
+    }
+
+    // Moves the reader to the latest value; false if it already holds it
+    bool acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fresh) return false;
+        std::swap(frontIndex, readyIndex);
+        fresh = false;
+        return true;
+    }
+
+    // Slot the reader holds; only the reader may touch it
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    T slots[3];
+    int backIndex = 0;
+    int readyIndex = 1;
+    int frontIndex = 2;
+    bool fresh = false;  // readyIndex holds a value the reader has not taken
+    mutable std::mutex mutex;
+};
+
+#endif // TRIPLE_BUFFER_H